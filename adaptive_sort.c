@@ -0,0 +1,198 @@
+/**
+* @file adaptive_sort.c
+* @brief Run detection and run-head heap merge
+*/
+
+#include <stdint.h>
+#include "adaptive_sort.h"
+#include "heap_generic.h"
+#include "simd_sort.h"
+#include "hugemem.h"
+
+/**
+	\brief struct run_head: smallest not yet merged value of one run
+*/
+typedef struct run_head
+{
+	/** Current value of the run */
+	int val;
+	/** Run it belongs to, also breaks ties so equal values keep run order */
+	uint32_t run;
+}run_head;
+
+#define RUN_HEAD_LT(a, b) \
+	(((a).val < (b).val) || (((a).val == (b).val) && ((a).run < (b).run)))
+
+GEN_HEAP(runhead, run_head, RUN_HEAD_LT)
+GEN_HEAP(aint, int, KEY_LT)
+
+/*!*******************************************************
+*	\fn reverse(int *a, size_t lo, size_t hi)
+*	\brief - reverse a[lo..hi)
+*	\param a - array
+*	\param lo - first index
+*	\param hi - one past the last index
+*	\return void
+*********************************************************/
+static void reverse(int *a, size_t lo, size_t hi)
+{
+	int t = 0;
+	while((lo + 1) < hi)
+	{
+		hi--;
+		t = a[lo]; a[lo] = a[hi]; a[hi] = t;
+		lo++;
+	}
+}
+
+/*!*******************************************************
+*	\fn count_runs(int *a, size_t n, size_t *starts, size_t max_runs)
+*	\brief - split a[] into non-descending runs in one pass. Strictly
+*		 descending runs are reversed in place as they are found,
+*		 and a run that continues the previous one is joined to it.
+*	\param a - array to scan
+*	\param n - number of elements
+*	\param starts - out: start index of every run, may be NULL
+*	\param max_runs - stop counting once this many runs are found
+*	\return size_t - number of runs, max_runs + 1 if the scan stopped early
+*********************************************************/
+size_t count_runs(int *a, size_t n, size_t *starts, size_t max_runs)
+{
+	size_t runs = 0;
+	size_t i = 0;
+	size_t j = 0;
+
+	while(i < n)
+	{
+		j = i + 1;
+		if((j < n) && (a[j] < a[i]))
+		{
+			/* Strictly descending only, reversing equal keys would reorder them */
+			while((j < n) && (a[j] < a[j - 1]))
+				j++;
+			reverse(a, i, j);
+		}
+		else
+		{
+			while((j < n) && (a[j] >= a[j - 1]))
+				j++;
+		}
+
+		/* Only a new run if it doesn't simply carry on from the last one */
+		if((0 == runs) || (a[i - 1] > a[i]))
+		{
+			if(runs == max_runs)
+				return (max_runs + 1);
+			if(NULL != starts)
+				starts[runs] = i;
+			runs++;
+		}
+		i = j;
+	}
+	return (runs);
+}
+
+/*!*******************************************************
+*	\fn merge_runs(int *a, size_t n, size_t *starts, size_t runs)
+*	\brief - k-way merge of the runs through a heap of run heads
+*	\param a - array holding the runs back to back
+*	\param n - number of elements
+*	\param starts - start index of every run
+*	\param runs - number of runs
+*	\return bool - FALSE if out of memory
+*********************************************************/
+static bool merge_runs(int *a, size_t n, size_t *starts, size_t runs)
+{
+	int *out = (int*) huge_alloc(n * sizeof(*out));
+	size_t *pos = (size_t*) malloc((runs + 1) * sizeof(*pos));
+	run_head *heads = (run_head*) malloc(runs * sizeof(*heads));
+	size_t live = runs;
+	size_t i = 0;
+	uint32_t r = 0;
+
+	if((NULL == out) || (NULL == pos) || (NULL == heads))
+	{
+		huge_free(out, n * sizeof(*out));
+		free(pos);
+		free(heads);
+		return (FALSE);
+	}
+
+	if(2 == runs)
+	{
+		/* Sorted data plus an appended tail: one two-way merge, no heap */
+		simd_merge(a, starts[1], a + starts[1], n - starts[1], out);
+		goto done;
+	}
+
+	for(i = 0; i < runs; i++)
+	{
+		pos[i] = starts[i];
+		heads[i].val = a[starts[i]];
+		heads[i].run = (uint32_t) i;
+	}
+	/* Sentinel: end of the last run */
+	starts[runs] = n;
+	runhead_heapify(heads, live);
+
+	for(i = 0; i < n; i++)
+	{
+		r = heads[0].run;
+		out[i] = heads[0].val;
+		/* Replace the top with the run's next value rather than pop + push,
+		   that is one sift-down per element */
+		if(++pos[r] < starts[r + 1])
+			heads[0].val = a[pos[r]];
+		else
+			heads[0] = heads[--live];
+		if(0 != live)
+			runhead_sift_down(heads, live, 0);
+	}
+
+done:
+	memcpy(a, out, n * sizeof(*a));
+	huge_free(out, n * sizeof(*out));
+	free(pos);
+	free(heads);
+	return (TRUE);
+}
+
+/*!*******************************************************
+*	\fn adaptive_sort(int *a, size_t n)
+*	\brief - sort a[] ascending, in close to O(n) when it is nearly sorted
+*	\param a - array to sort
+*	\param n - number of elements
+*	\return bool - FALSE if out of memory (a[] is then left unsorted)
+*********************************************************/
+bool adaptive_sort(int *a, size_t n)
+{
+	size_t max_runs = (n / ADAPT_MIN_AVG_RUN) + 1;
+	size_t *starts = NULL;
+	size_t runs = 0;
+	bool ok = TRUE;
+
+	/* Too small for run detection to pay off, a sorting network is
+	   cheaper than even the scan */
+	if(n <= SIMD_SORT_MAX)
+		return (simd_sort(a, n));
+
+	/* One spare slot for merge_runs()' end sentinel */
+	starts = (size_t*) malloc((max_runs + 2) * sizeof(*starts));
+	if(NULL == starts)
+		return (FALSE);
+
+	runs = count_runs(a, n, starts, max_runs);
+	if(runs > max_runs)
+	{
+		/* Too little order to exploit */
+		PRINT("adaptive_sort: no long runs, heapsorting %zu values\n", n);
+		aint_heapsort(a, n);
+	}
+	else if(runs > 1)
+	{
+		PRINT("adaptive_sort: merging %zu runs\n", runs);
+		ok = merge_runs(a, n, starts, runs);
+	}
+	free(starts);
+	return (ok);
+}
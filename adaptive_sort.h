@@ -0,0 +1,43 @@
+/**
+* @file adaptive_sort.h
+* @brief Adaptive sort for nearly ordered input. A single pass finds the
+*        ascending and descending runs already present in the data; sorted
+*        or reversed input is done after that pass, and otherwise the runs
+*        are merged through a heap holding one head per run, which costs
+*        O(n log runs) instead of O(n log n). Two runs go through the
+*        vector merge kernel instead, and inputs of up to SIMD_SORT_MAX
+*        straight to the sorting network (simd_sort.h).
+*/
+
+#ifndef _ADAPTIVE_SORT_H_
+#define _ADAPTIVE_SORT_H_
+
+#include "heapsort.h"
+
+/** Below this average run length the input is treated as random and
+    heapsorted directly, merging would only add overhead */
+#define ADAPT_MIN_AVG_RUN	(8)
+
+/*!*******************************************************
+*	\fn count_runs(int *a, size_t n, size_t *starts, size_t max_runs)
+*	\brief - split a[] into non-descending runs in one pass. Strictly
+*		 descending runs are reversed in place as they are found,
+*		 and a run that continues the previous one is joined to it.
+*	\param a - array to scan
+*	\param n - number of elements
+*	\param starts - out: start index of every run, may be NULL
+*	\param max_runs - stop counting once this many runs are found
+*	\return size_t - number of runs, max_runs + 1 if the scan stopped early
+*********************************************************/
+size_t count_runs(int *a, size_t n, size_t *starts, size_t max_runs);
+
+/*!*******************************************************
+*	\fn adaptive_sort(int *a, size_t n)
+*	\brief - sort a[] ascending, in close to O(n) when it is nearly sorted
+*	\param a - array to sort
+*	\param n - number of elements
+*	\return bool - FALSE if out of memory (a[] is then left unsorted)
+*********************************************************/
+bool adaptive_sort(int *a, size_t n);
+
+#endif // _ADAPTIVE_SORT_H_
@@ -0,0 +1,1157 @@
+/**
+* @file bench.c
+* @brief Benchmark driver for the sort engines.
+*
+*        Build: gcc -O2 -DHEAPSORT -DNO_DEBUG -DHEAPSORT_NO_MAIN -o bench bench.c \
+*                   heapsort.c heap_util.c adaptive_sort.c eytzinger.c \
+*                   epoch.c cbst.c lflist.c snapshot.c simd_sort.c hybrid_sort.c \
+*                   bst_stats.c bst_bulk.c timerq.c hugemem.c stable_sort.c \
+*                   record_sort.c -lpthread
+*        Usage: ./bench [n] [adaptive|small|hybrid|lookup|snap|cbst|lflist|timer|huge|stable]
+*
+*        add_node() is built with HEAPSORT for the sort benchmarks, so the
+*        search trees used by the lookup benchmarks are built by bst_insert().
+*/
+
+#include <stddef.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "heapsort.h"
+#include "heap_generic.h"
+#include "adaptive_sort.h"
+#include "simd_sort.h"
+#include "hybrid_sort.h"
+#include "eytzinger.h"
+#include "cbst.h"
+#include "lflist.h"
+#include "snapshot.h"
+#include "timerq.h"
+#include "hugemem.h"
+#include "stable_sort.h"
+
+GEN_HEAP(bint, int, KEY_LT)
+GEN_HEAP_ALLOC(hbint, int, KEY_LT, huge_realloc, huge_free)
+
+/** Default number of elements */
+#define BENCH_DEFAULT_N		(1000000)
+
+/** Lookups per lookup benchmark run */
+#define BENCH_LOOKUPS		(4000000)
+
+/** Length of each concurrent benchmark run, in seconds */
+#define BENCH_CONC_SECS		(1.0)
+
+/** Scratch file of the snapshot benchmark */
+#define BENCH_SNAP_PATH		"/tmp/bench.snap"
+
+/** Key range of the list benchmark; the list is preloaded with half of it.
+    Every list operation is a linear walk, so this stays small. */
+#define BENCH_LIST_KEYS		(1024)
+
+/** Timers kept armed by the timer benchmark, and how far out (in ticks)
+    a timer is re-armed; a quarter of them land past the wheel */
+#define BENCH_TIMERS		(20000)
+#define BENCH_TIMER_SPAN	(TQ_WHEEL_SLOTS * 4 / 3)
+
+/** Ticks the timer benchmark's event loop runs for. Re-armed deadlines
+    only grow, so add_node() keeps walking down the right spine and the
+    pointer heap gets a much shorter run. */
+#define BENCH_TIMER_TICKS	(100000)
+#define BENCH_TIMER_NODE_TICKS	(1000)
+
+/** The pointer heap degenerates to a list on ordered input (add_node()
+    recursion depth == n), so it is only run up to this size */
+#define BENCH_NODE_MAX		(20000)
+
+/** Input shapes */
+typedef enum _dist
+{
+	DIST_RANDOM = 0,
+	DIST_SORTED,
+	DIST_REVERSED,
+	DIST_TAIL,		/**< sorted, last 1% random (appended records) */
+	DIST_SWAPS,		/**< sorted, 1% of the pairs swapped */
+	DIST_FEW_UNIQUE,	/**< 16 distinct values */
+	DIST_COUNT
+}dist;
+
+static const char *dist_name[DIST_COUNT] =
+{
+	"random", "sorted", "reversed", "sorted+tail", "sorted+swaps", "few-unique"
+};
+
+/*!*******************************************************
+*	\fn now_sec
+*	\brief - monotonic clock in seconds
+*	\return double - seconds
+*********************************************************/
+static double now_sec(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec + (ts.tv_nsec * 1e-9));
+}
+
+/*!*******************************************************
+*	\fn fill(int *a, size_t n, dist d)
+*	\brief - fill a[] with the given distribution
+*	\param a - array
+*	\param n - number of elements
+*	\param d - distribution
+*	\return void
+*********************************************************/
+static void fill(int *a, size_t n, dist d)
+{
+	size_t i = 0;
+	size_t j = 0;
+	int t = 0;
+
+	for(i = 0; i < n; i++)
+	{
+		switch(d)
+		{
+			case DIST_RANDOM:	a[i] = rand(); break;
+			case DIST_REVERSED:	a[i] = (int)(n - i); break;
+			case DIST_FEW_UNIQUE:	a[i] = rand() % 16; break;
+			default:		a[i] = (int) i; break;
+		}
+	}
+	if(DIST_TAIL == d)
+	{
+		for(i = n - (n / 100); i < n; i++)
+			a[i] = rand() % (int) n;
+	}
+	else if(DIST_SWAPS == d)
+	{
+		for(j = 0; j < (n / 100); j++)
+		{
+			i = rand() % n;
+			t = a[i]; a[i] = a[(i + 1) % n]; a[(i + 1) % n] = t;
+		}
+	}
+}
+
+/*!*******************************************************
+*	\fn check_sorted(const int *a, size_t n)
+*	\brief - verify ascending order
+*	\param a - array
+*	\param n - number of elements
+*	\return bool - TRUE if sorted
+*********************************************************/
+static bool check_sorted(const int *a, size_t n)
+{
+	size_t i = 0;
+	for(i = 1; i < n; i++)
+		if(a[i - 1] > a[i])
+			return (FALSE);
+	return (TRUE);
+}
+
+/*!*******************************************************
+*	\fn collect(int data, void *ctx)
+*	\brief - emit_fn storing the extracted values in an array
+*	\param data - extracted value
+*	\param ctx - int ** cursor into the output array
+*	\return void
+*********************************************************/
+static void collect(int data, void *ctx)
+{
+	int **out = (int**) ctx;
+	*(*out)++ = data;
+}
+
+/*!*******************************************************
+*	\fn node_sort(int *a, size_t n)
+*	\brief - the original engine: add_node() every value then sort_emit()
+*	\param a - array, sorted on return
+*	\param n - number of elements
+*	\return void
+*********************************************************/
+static void node_sort(int *a, size_t n)
+{
+	node *root = NULL;
+	int *cur = a;
+	size_t i = 0;
+
+	for(i = 0; i < n; i++)
+		add_node(&root, a[i], root);
+	sort_emit(&root, collect, &cur);
+}
+
+/*!*******************************************************
+*	\fn report(const char *engine, dist d, size_t n, double t, bool ok)
+*	\brief - print one result line
+*********************************************************/
+static void report(const char *engine, dist d, size_t n, double t, bool ok)
+{
+	printf("%-18s %-14s %10zu %10.3f ms %8.1f Mel/s %s\n", engine, dist_name[d],
+	       n, t * 1e3, (n / t) * 1e-6, (TRUE == ok) ? "" : "NOT SORTED");
+}
+
+/*!*******************************************************
+*	\fn bench_adaptive(size_t n)
+*	\brief - adaptive_sort() against the heap engines on every distribution
+*	\param n - number of elements
+*	\return void
+*********************************************************/
+static void bench_adaptive(size_t n)
+{
+	int *src = (int*) malloc(n * sizeof(*src));
+	int *a = (int*) malloc(n * sizeof(*a));
+	size_t nn = (n < BENCH_NODE_MAX) ? n : BENCH_NODE_MAX;
+	double t = 0;
+	int d = 0;
+
+	if((NULL == src) || (NULL == a))
+		return;
+	for(d = 0; d < DIST_COUNT; d++)
+	{
+		fill(src, n, (dist) d);
+
+		memcpy(a, src, n * sizeof(*a));
+		t = now_sec();
+		bint_heapsort(a, n);
+		report("heapsort", (dist) d, n, now_sec() - t, check_sorted(a, n));
+
+		memcpy(a, src, n * sizeof(*a));
+		t = now_sec();
+		adaptive_sort(a, n);
+		report("adaptive_sort", (dist) d, n, now_sec() - t, check_sorted(a, n));
+
+		/* Node engine on a shortened copy of the same shape */
+		fill(a, nn, (dist) d);
+		t = now_sec();
+		node_sort(a, nn);
+		report("sort()", (dist) d, nn, now_sec() - t, check_sorted(a, nn));
+	}
+	free(src);
+	free(a);
+}
+
+/*!*******************************************************
+*	\fn bench_small(size_t n)
+*	\brief - n values sorted as many independent small batches, the
+*		 heap engines against every sorting network kernel the CPU
+*		 runs, then the merge kernels on two runs of n / 2
+*	\param n - values per measurement
+*	\return void
+*********************************************************/
+static void bench_small(size_t n)
+{
+	int *src = (int*) malloc(n * sizeof(*src));
+	int *a = (int*) malloc(n * sizeof(*a));
+	int *out = (int*) malloc(n * sizeof(*out));
+	simd_isa best = simd_sort_isa();
+	size_t batch = 0;
+	size_t i = 0;
+	bool ok = TRUE;
+	char name[32];
+	double t = 0;
+	int isa = 0;
+
+	if((NULL == src) || (NULL == a) || (NULL == out))
+		return;
+	fill(src, n, DIST_RANDOM);
+	for(batch = 16; batch <= SIMD_SORT_MAX; batch *= 2)
+	{
+		n -= n % batch;
+
+		memcpy(a, src, n * sizeof(*a));
+		t = now_sec();
+		for(i = 0; i < n; i += batch)
+			bint_heapsort(a + i, batch);
+		t = now_sec() - t;
+		for(i = 0, ok = TRUE; i < n; i += batch)
+			ok = (TRUE == ok) ? check_sorted(a + i, batch) : FALSE;
+		printf("batch %3zu %-10s %10.3f ms %8.1f Mel/s %s\n", batch, "heapsort", t * 1e3,
+		       (n / t) * 1e-6, (TRUE == ok) ? "" : "NOT SORTED");
+
+		memcpy(a, src, n * sizeof(*a));
+		t = now_sec();
+		for(i = 0; i < n; i += batch)
+			node_sort(a + i, batch);
+		t = now_sec() - t;
+		for(i = 0, ok = TRUE; i < n; i += batch)
+			ok = (TRUE == ok) ? check_sorted(a + i, batch) : FALSE;
+		printf("batch %3zu %-10s %10.3f ms %8.1f Mel/s %s\n", batch, "sort()", t * 1e3,
+		       (n / t) * 1e-6, (TRUE == ok) ? "" : "NOT SORTED");
+
+		for(isa = SIMD_SCALAR; isa < SIMD_ISA_COUNT; isa++)
+		{
+			if(FALSE == simd_sort_set_isa((simd_isa) isa))
+				continue;
+			memcpy(a, src, n * sizeof(*a));
+			t = now_sec();
+			for(i = 0; i < n; i += batch)
+				simd_sort(a + i, batch);
+			t = now_sec() - t;
+			for(i = 0, ok = TRUE; i < n; i += batch)
+				ok = (TRUE == ok) ? check_sorted(a + i, batch) : FALSE;
+			snprintf(name, sizeof(name), "net-%s", simd_isa_name[isa]);
+			printf("batch %3zu %-10s %10.3f ms %8.1f Mel/s %s\n", batch, name, t * 1e3,
+			       (n / t) * 1e-6, (TRUE == ok) ? "" : "NOT SORTED");
+		}
+	}
+
+	/* Two sorted halves, interleaved values so the merge can't coast */
+	memcpy(a, src, n * sizeof(*a));
+	bint_heapsort(a, n / 2);
+	bint_heapsort(a + (n / 2), n - (n / 2));
+	for(isa = SIMD_SCALAR; isa < SIMD_ISA_COUNT; isa++)
+	{
+		if(FALSE == simd_sort_set_isa((simd_isa) isa))
+			continue;
+		t = now_sec();
+		simd_merge(a, n / 2, a + (n / 2), n - (n / 2), out);
+		t = now_sec() - t;
+		snprintf(name, sizeof(name), "merge-%s", simd_isa_name[isa]);
+		printf("%-20s %10.3f ms %8.1f Mel/s %s\n", name, t * 1e3, (n / t) * 1e-6,
+		       (TRUE == check_sorted(out, n)) ? "" : "NOT SORTED");
+	}
+	simd_sort_set_isa(best);
+	free(src);
+	free(a);
+	free(out);
+}
+
+/*!*******************************************************
+*	\fn bench_hybrid(size_t n)
+*	\brief - hybrid_sort() and the algorithms it picks from, against the
+*		 heap engines, on every distribution
+*	\param n - number of elements
+*	\return void
+*********************************************************/
+static void bench_hybrid(size_t n)
+{
+	int *src = (int*) malloc(n * sizeof(*src));
+	int *a = (int*) malloc(n * sizeof(*a));
+	size_t nn = (n < BENCH_NODE_MAX) ? n : BENCH_NODE_MAX;
+	hybrid_plan plan = HYBRID_INTRO;
+	char name[32];
+	double t = 0;
+	int d = 0;
+
+	if((NULL == src) || (NULL == a))
+		return;
+	for(d = 0; d < DIST_COUNT; d++)
+	{
+		fill(src, n, (dist) d);
+
+		memcpy(a, src, n * sizeof(*a));
+		t = now_sec();
+		bint_heapsort(a, n);
+		report("heapsort", (dist) d, n, now_sec() - t, check_sorted(a, n));
+
+		memcpy(a, src, n * sizeof(*a));
+		t = now_sec();
+		intro_sort(a, n);
+		report("intro_sort", (dist) d, n, now_sec() - t, check_sorted(a, n));
+
+		memcpy(a, src, n * sizeof(*a));
+		t = now_sec();
+		radix_sort(a, n);
+		report("radix_sort", (dist) d, n, now_sec() - t, check_sorted(a, n));
+
+		memcpy(a, src, n * sizeof(*a));
+		t = now_sec();
+		plan = hybrid_sort(a, n);
+		snprintf(name, sizeof(name), "hybrid/%s", hybrid_plan_name[plan]);
+		report(name, (dist) d, n, now_sec() - t, check_sorted(a, n));
+
+		/* sort() and hybrid_sort() on the same shortened copy */
+		fill(a, nn, (dist) d);
+		t = now_sec();
+		node_sort(a, nn);
+		report("sort()", (dist) d, nn, now_sec() - t, check_sorted(a, nn));
+
+		fill(a, nn, (dist) d);
+		t = now_sec();
+		plan = hybrid_sort(a, nn);
+		snprintf(name, sizeof(name), "hybrid/%s", hybrid_plan_name[plan]);
+		report(name, (dist) d, nn, now_sec() - t, check_sorted(a, nn));
+	}
+	free(src);
+	free(a);
+}
+
+/*!*******************************************************
+*	\fn bst_insert(node **root, int data)
+*	\brief - add_node() without the HEAPSORT normalization, iterative
+*	\param root - tree root
+*	\param data - key to add
+*	\return void
+*********************************************************/
+static void bst_insert(node **root, int data)
+{
+	node *parent = NULL;
+	while(NULL != *root)
+	{
+		parent = *root;
+		parent->size++;
+		root = &parent->link[DIR(data, parent->data)];
+	}
+	*root = create_node(data, parent);
+}
+
+/*!*******************************************************
+*	\fn bench_lookup(size_t n)
+*	\brief - find_node() on the pointer tree against eyt_find() on the
+*		 same keys frozen into the Eytzinger layout, one at a time
+*		 and batched
+*	\param n - number of keys
+*	\return void
+*********************************************************/
+static void bench_lookup(size_t n)
+{
+	int *keys = (int*) malloc(n * sizeof(*keys));
+	int *probe = (int*) malloc(BENCH_LOOKUPS * sizeof(*probe));
+	node **nodes = (node**) malloc(BENCH_LOOKUPS * sizeof(*nodes));
+	bool *hit = (bool*) malloc(BENCH_LOOKUPS * sizeof(*hit));
+	node *root = NULL;
+	eyt_index idx;
+	size_t found = 0;
+	size_t i = 0;
+	double t = 0;
+
+	if((NULL == keys) || (NULL == probe))
+		return;
+	/* Random insertion order keeps the unbalanced tree O(log n) deep */
+	fill(keys, n, DIST_RANDOM);
+	for(i = 0; i < n; i++)
+		bst_insert(&root, keys[i]);
+	for(i = 0; i < BENCH_LOOKUPS; i++)
+		probe[i] = (0 == (i & 1)) ? keys[rand() % n] : rand();
+
+	t = now_sec();
+	for(i = 0; i < BENCH_LOOKUPS; i++)
+		found += (NULL != find_node(root, probe[i]));
+	t = now_sec() - t;
+	printf("%-16s %10zu keys %10.1f Mlookups/s (%zu hits)\n", "find_node",
+	       n, (BENCH_LOOKUPS / t) * 1e-6, found);
+
+	if(NULL != nodes)
+	{
+		t = now_sec();
+		found = find_nodes_batch(root, probe, BENCH_LOOKUPS, nodes);
+		t = now_sec() - t;
+		printf("%-16s %10zu keys %10.1f Mlookups/s (%zu hits)\n", "find_nodes_batch",
+		       n, (BENCH_LOOKUPS / t) * 1e-6, found);
+	}
+
+	found = 0;
+	if(TRUE == eyt_freeze_tree(&idx, root))
+	{
+		t = now_sec();
+		for(i = 0; i < BENCH_LOOKUPS; i++)
+			found += eyt_find(&idx, probe[i]);
+		t = now_sec() - t;
+		printf("%-16s %10zu keys %10.1f Mlookups/s (%zu hits)\n", "eyt_find",
+		       n, (BENCH_LOOKUPS / t) * 1e-6, found);
+
+		if(NULL != hit)
+		{
+			t = now_sec();
+			found = eyt_find_batch(&idx, probe, BENCH_LOOKUPS, hit);
+			t = now_sec() - t;
+			printf("%-16s %10zu keys %10.1f Mlookups/s (%zu hits)\n", "eyt_find_batch",
+			       n, (BENCH_LOOKUPS / t) * 1e-6, found);
+		}
+		eyt_free(&idx);
+	}
+	free(nodes);
+	free(hit);
+	free_tree(root);
+	free(keys);
+	free(probe);
+}
+
+/*!*******************************************************
+*	\fn bench_snap(size_t n)
+*	\brief - restart cost: rebuilding a tree key by key against mapping
+*		 a snapshot of it, with and without the checksum pass, and
+*		 against turning the mapping back into pointers
+*	\param n - number of keys
+*	\return void
+*********************************************************/
+static void bench_snap(size_t n)
+{
+	int *keys = (int*) malloc(n * sizeof(*keys));
+	node *root = NULL;
+	node *copy = NULL;
+	snapshot snap;
+	size_t found = 0;
+	size_t i = 0;
+	double t = 0;
+
+	if(NULL == keys)
+		return;
+	fill(keys, n, DIST_RANDOM);
+	t = now_sec();
+	for(i = 0; i < n; i++)
+		bst_insert(&root, keys[i]);
+	printf("%-16s %10zu keys %10.3f ms\n", "rebuild", n, (now_sec() - t) * 1e3);
+
+	t = now_sec();
+	if(FALSE == snap_save(BENCH_SNAP_PATH, root, SNAP_BST))
+	{
+		printf("snap_save %s failed\n", BENCH_SNAP_PATH);
+		free_tree(root);
+		free(keys);
+		return;
+	}
+	printf("%-16s %10zu keys %10.3f ms\n", "snap_save", n, (now_sec() - t) * 1e3);
+
+	t = now_sec();
+	if(TRUE == snap_map(&snap, BENCH_SNAP_PATH, 0))
+	{
+		/* The first lookups include the page faults on the mapping */
+		for(i = 0; i < 1000; i++)
+			found += (SNAP_NIL != snap_find(&snap, keys[i % n]));
+		printf("%-16s %10zu keys %10.3f ms (+1000 lookups, %zu hits)\n", "snap_map",
+		       n, (now_sec() - t) * 1e3, found);
+		snap_unmap(&snap);
+	}
+
+	t = now_sec();
+	if(TRUE == snap_map(&snap, BENCH_SNAP_PATH, SNAP_VERIFY))
+	{
+		printf("%-16s %10zu keys %10.3f ms\n", "snap_map+verify", n, (now_sec() - t) * 1e3);
+		t = now_sec();
+		if(TRUE == snap_restore(&snap, &copy))
+		{
+			printf("%-16s %10zu keys %10.3f ms\n", "snap_restore", n, (now_sec() - t) * 1e3);
+			free_tree(copy);
+		}
+		snap_unmap(&snap);
+	}
+	unlink(BENCH_SNAP_PATH);
+	free_tree(root);
+	free(keys);
+}
+
+/**
+	\brief struct conc_arg: shared state of a concurrent benchmark run
+*/
+typedef struct conc_arg
+{
+	cbst *tree;
+	size_t keyspace;
+	_Atomic int stop;
+	_Atomic size_t ops;
+}conc_arg;
+
+/*!*******************************************************
+*	\fn cbst_reader(void *arg)
+*	\brief - reader thread: random cbst_find() until told to stop
+*	\param arg - conc_arg
+*	\return NULL
+*********************************************************/
+static void* cbst_reader(void *arg)
+{
+	conc_arg *c = (conc_arg*) arg;
+	int tid = cbst_register(c->tree);
+	unsigned int seed = (unsigned int) tid;
+	size_t ops = 0;
+	int i = 0;
+
+	while(0 == atomic_load_explicit(&c->stop, memory_order_relaxed))
+	{
+		for(i = 0; i < 1024; i++)
+			cbst_find(c->tree, tid, rand_r(&seed) % c->keyspace);
+		ops += 1024;
+	}
+	atomic_fetch_add(&c->ops, ops);
+	return (NULL);
+}
+
+/*!*******************************************************
+*	\fn bench_cbst(size_t n)
+*	\brief - read throughput of the concurrent tree from 1 reader up to
+*		 one per CPU, with a writer inserting the whole time
+*	\param n - keys preloaded, the writer keeps adding more
+*	\return void
+*********************************************************/
+static void bench_cbst(size_t n)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	pthread_t *tids = (pthread_t*) malloc(cpus * sizeof(*tids));
+	conc_arg c;
+	cbst tree;
+	size_t writes = 0;
+	size_t i = 0;
+	long r = 0;
+	int w = 0;
+	double t = 0;
+
+	for(r = 1; (NULL != tids) && (r <= cpus); r++)
+	{
+		if(FALSE == cbst_init(&tree, (int) r + 1))
+			break;
+		w = cbst_register(&tree);
+		for(i = 0; i < n; i++)
+			cbst_insert(&tree, w, rand() % (int)(2 * n));
+
+		c.tree = &tree;
+		c.keyspace = 2 * n;
+		atomic_init(&c.stop, 0);
+		atomic_init(&c.ops, 0);
+		for(i = 0; i < (size_t) r; i++)
+			pthread_create(&tids[i], NULL, cbst_reader, &c);
+
+		writes = 0;
+		t = now_sec();
+		while((now_sec() - t) < BENCH_CONC_SECS)
+		{
+			cbst_insert(&tree, w, rand() % (int)(2 * n));
+			writes++;
+		}
+		atomic_store(&c.stop, 1);
+		for(i = 0; i < (size_t) r; i++)
+			pthread_join(tids[i], NULL);
+		t = now_sec() - t;
+
+		printf("cbst %2ld readers %10.2f Mreads/s (%6.2f per reader) %8.1f Kwrites/s\n",
+		       r, (atomic_load(&c.ops) / t) * 1e-6, (atomic_load(&c.ops) / t / r) * 1e-6,
+		       (writes / t) * 1e-3);
+		cbst_free(&tree);
+	}
+	free(tids);
+}
+
+/**
+	\brief struct lf_arg: shared state of a list benchmark run
+*/
+typedef struct lf_arg
+{
+	lflist *list;
+	_Atomic int stop;
+	_Atomic size_t ops;
+}lf_arg;
+
+/*!*******************************************************
+*	\fn lflist_worker(void *arg)
+*	\brief - worker thread: 50% find, 25% insert, 25% delete on random
+*		 keys until told to stop. Inserts are lflist_add(), so the
+*		 list settles at about half the key range.
+*	\param arg - lf_arg
+*	\return NULL
+*********************************************************/
+static void* lflist_worker(void *arg)
+{
+	lf_arg *c = (lf_arg*) arg;
+	int tid = lflist_register(c->list);
+	unsigned int seed = (unsigned int) tid;
+	unsigned int r = 0;
+	size_t ops = 0;
+	int i = 0;
+
+	while(0 == atomic_load_explicit(&c->stop, memory_order_relaxed))
+	{
+		for(i = 0; i < 256; i++)
+		{
+			r = (unsigned int) rand_r(&seed);
+			switch(r & 3)
+			{
+				case 0:
+					lflist_add(c->list, tid, (r >> 2) % BENCH_LIST_KEYS);
+					break;
+				case 1:
+					lflist_delete(c->list, tid, (r >> 2) % BENCH_LIST_KEYS);
+					break;
+				default:
+					lflist_find(c->list, tid, (r >> 2) % BENCH_LIST_KEYS);
+					break;
+			}
+		}
+		ops += 256;
+	}
+	atomic_fetch_add(&c->ops, ops);
+	return (NULL);
+}
+
+/*!*******************************************************
+*	\fn bench_lflist(void)
+*	\brief - mixed workload throughput of the lock-free list from 1
+*		 thread up to two per CPU
+*	\return void
+*********************************************************/
+static void bench_lflist(void)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	long max = (cpus < 2) ? 4 : (2 * cpus);
+	pthread_t *tids = (pthread_t*) malloc(max * sizeof(*tids));
+	lf_arg c;
+	lflist list;
+	long r = 0;
+	int i = 0;
+	int w = 0;
+	double t = 0;
+
+	for(r = 1; (NULL != tids) && (r <= max); r *= 2)
+	{
+		if(FALSE == lflist_init(&list, (int) r + 1))
+			break;
+		w = lflist_register(&list);
+		for(i = 0; i < BENCH_LIST_KEYS / 2; i++)
+			lflist_add(&list, w, rand() % BENCH_LIST_KEYS);
+
+		c.list = &list;
+		atomic_init(&c.stop, 0);
+		atomic_init(&c.ops, 0);
+		t = now_sec();
+		for(i = 0; i < r; i++)
+			pthread_create(&tids[i], NULL, lflist_worker, &c);
+		while((now_sec() - t) < BENCH_CONC_SECS)
+			usleep(10000);
+		atomic_store(&c.stop, 1);
+		for(i = 0; i < r; i++)
+			pthread_join(tids[i], NULL);
+		t = now_sec() - t;
+
+		printf("lflist %2ld threads %10.2f Mops/s (%6.2f per thread)\n",
+		       r, (atomic_load(&c.ops) / t) * 1e-6, (atomic_load(&c.ops) / t / r) * 1e-6);
+		lflist_free(&list);
+	}
+	free(tids);
+}
+
+/*!*******************************************************
+*	\fn bench_timer(void)
+*	\brief - event loop simulation: every tick fire the timers due and
+*		 re-arm each one a random distance out. The node heap pops
+*		 with extract_until(), the array heap one value at a time, the
+*		 timer queue a batch per call.
+*	\return void
+*********************************************************/
+static void bench_timer(void)
+{
+	int *fired = (int*) malloc(BENCH_TIMERS * sizeof(*fired));
+	timer_ev *ev = (timer_ev*) malloc(BENCH_TIMERS * sizeof(*ev));
+	unsigned int seed = 1;
+	size_t total = 0;
+	size_t got = 0;
+	size_t i = 0;
+	uint64_t tick = 0;
+	node *root = NULL;
+	bint_heap h = {0};
+	timerq q;
+	int v = 0;
+	double t = 0;
+
+	if((NULL == fired) || (NULL == ev))
+	{
+		free(fired);
+		free(ev);
+		return;
+	}
+
+	/* Pointer heap */
+	for(i = 0; i < BENCH_TIMERS; i++)
+		add_node(&root, 1 + (rand_r(&seed) % BENCH_TIMER_SPAN), root);
+	t = now_sec();
+	for(tick = 0; tick < BENCH_TIMER_NODE_TICKS; tick++)
+	{
+		got = extract_until(&root, (int) tick, fired, BENCH_TIMERS);
+		for(i = 0; i < got; i++)
+			add_node(&root, (int) tick + 1 + (rand_r(&seed) % BENCH_TIMER_SPAN), root);
+		total += got;
+	}
+	t = now_sec() - t;
+	printf("timer %-12s %10zu fired %10.3f ms %8.1f Mev/s\n", "node-heap", total,
+	       t * 1e3, (total / t) * 1e-6);
+	while(TRUE == extract_min(&root, &v))
+		;
+
+	/* Array heap, one pop per timer */
+	seed = 1;
+	total = 0;
+	for(i = 0; i < BENCH_TIMERS; i++)
+		bint_heap_push(&h, 1 + (rand_r(&seed) % BENCH_TIMER_SPAN));
+	t = now_sec();
+	for(tick = 0; tick < BENCH_TIMER_TICKS; tick++)
+	{
+		got = 0;
+		while((0 != h.n) && (h.v[0] <= (int) tick))
+			bint_heap_pop(&h, &fired[got++]);
+		for(i = 0; i < got; i++)
+			bint_heap_push(&h, (int) tick + 1 + (rand_r(&seed) % BENCH_TIMER_SPAN));
+		total += got;
+	}
+	t = now_sec() - t;
+	printf("timer %-12s %10zu fired %10.3f ms %8.1f Mev/s\n", "array-heap", total,
+	       t * 1e3, (total / t) * 1e-6);
+	bint_heap_free(&h);
+
+	/* Timer queue, batched pops and pushes */
+	seed = 1;
+	total = 0;
+	timerq_init(&q, 0);
+	for(i = 0; i < BENCH_TIMERS; i++)
+	{
+		ev[i].deadline = 1 + (rand_r(&seed) % BENCH_TIMER_SPAN);
+		ev[i].id = i;
+	}
+	timerq_push_bulk(&q, ev, BENCH_TIMERS);
+	t = now_sec();
+	for(tick = 0; tick < BENCH_TIMER_TICKS; tick++)
+	{
+		got = timerq_pop_until(&q, tick, ev, BENCH_TIMERS);
+		for(i = 0; i < got; i++)
+			ev[i].deadline = tick + 1 + (rand_r(&seed) % BENCH_TIMER_SPAN);
+		timerq_push_bulk(&q, ev, got);
+		total += got;
+	}
+	t = now_sec() - t;
+	printf("timer %-12s %10zu fired %10.3f ms %8.1f Mev/s\n", "timerq", total,
+	       t * 1e3, (total / t) * 1e-6);
+	timerq_free(&q);
+
+	free(fired);
+	free(ev);
+}
+
+/** Counters of the huge page benchmark, read around each workload */
+typedef enum _tlb_ctr
+{
+	TLB_DTLB_MISS = 0,	/**< dTLB read misses, needs a hardware PMU */
+	TLB_PAGE_FAULT,		/**< page faults, one per 4 KB or per 2 MB page */
+	TLB_CTR_COUNT
+}tlb_ctr;
+
+/*!*******************************************************
+*	\fn tlb_open(int *fd)
+*	\brief - open the benchmark counters for this thread, user space
+*		 only. A counter the kernel or the CPU doesn't offer (no PMU
+*		 in most VMs) is left at -1.
+*	\param fd - out: TLB_CTR_COUNT descriptors
+*	\return void
+*********************************************************/
+static void tlb_open(int *fd)
+{
+	struct perf_event_attr attr;
+	int i = 0;
+
+	for(i = 0; i < TLB_CTR_COUNT; i++)
+	{
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		if(TLB_DTLB_MISS == i)
+		{
+			attr.type = PERF_TYPE_HW_CACHE;
+			attr.config = PERF_COUNT_HW_CACHE_DTLB |
+				      (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+				      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		}
+		else
+		{
+			attr.type = PERF_TYPE_SOFTWARE;
+			attr.config = PERF_COUNT_SW_PAGE_FAULTS;
+		}
+		fd[i] = (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+	}
+}
+
+/*!*******************************************************
+*	\fn tlb_start(const int *fd)
+*	\brief - zero and start the counters
+*	\param fd - descriptors from tlb_open()
+*	\return void
+*********************************************************/
+static void tlb_start(const int *fd)
+{
+	int i = 0;
+
+	for(i = 0; i < TLB_CTR_COUNT; i++)
+	{
+		if(fd[i] >= 0)
+		{
+			ioctl(fd[i], PERF_EVENT_IOC_RESET, 0);
+			ioctl(fd[i], PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+}
+
+/*!*******************************************************
+*	\fn tlb_stop(const int *fd, long long *val)
+*	\brief - stop the counters and read them
+*	\param fd - descriptors from tlb_open()
+*	\param val - out: TLB_CTR_COUNT values, -1 where there is no counter
+*	\return void
+*********************************************************/
+static void tlb_stop(const int *fd, long long *val)
+{
+	int i = 0;
+
+	for(i = 0; i < TLB_CTR_COUNT; i++)
+	{
+		val[i] = -1;
+		if(fd[i] >= 0)
+		{
+			ioctl(fd[i], PERF_EVENT_IOC_DISABLE, 0);
+			if(sizeof(val[i]) != read(fd[i], &val[i], sizeof(val[i])))
+				val[i] = -1;
+		}
+	}
+}
+
+/*!*******************************************************
+*	\fn anon_huge_mb(void)
+*	\brief - anonymous memory the kernel has actually put on
+*		 transparent huge pages, from /proc/self/smaps_rollup
+*	\return long - MB, -1 if it can't be read
+*********************************************************/
+static long anon_huge_mb(void)
+{
+	FILE *fp = fopen("/proc/self/smaps_rollup", "r");
+	char line[128];
+	long kb = -1;
+
+	if(NULL == fp)
+		return (-1);
+	while(NULL != fgets(line, sizeof(line), fp))
+	{
+		if(1 == sscanf(line, "AnonHugePages: %ld kB", &kb))
+			break;
+	}
+	fclose(fp);
+	return ((kb < 0) ? -1 : (kb / 1024));
+}
+
+/*!*******************************************************
+*	\fn huge_line(const char *what, size_t n, double t, const long long *val, long thp)
+*	\brief - print one huge page benchmark result
+*********************************************************/
+static void huge_line(const char *what, size_t n, double t, const long long *val, long thp)
+{
+	char miss[32];
+
+	if(val[TLB_DTLB_MISS] < 0)
+		snprintf(miss, sizeof(miss), "n/a");
+	else
+		snprintf(miss, sizeof(miss), "%lld", val[TLB_DTLB_MISS]);
+	printf("%-8s %-12s %10zu %10.3f ms  dTLB miss %14s  faults %9lld  THP %6ld MB\n",
+	       huge_mode_name[huge_get_mode()], what, n, t * 1e3, miss,
+	       val[TLB_PAGE_FAULT], thp);
+}
+
+/*!*******************************************************
+*	\fn bench_huge(size_t n)
+*	\brief - the large flat allocations on base pages, then advised to
+*		 THP, then on MAP_HUGETLB pages (which falls back to THP when
+*		 no pages are reserved): array heap push/pop, radix sort with
+*		 its scratch buffer, and random lookups in a bulk-built tree
+*		 and an Eytzinger index. The counters cover the timed part
+*		 only, page faults of the first touch included.
+*	\param n - number of elements
+*	\return void
+*********************************************************/
+static void bench_huge(size_t n)
+{
+	static const huge_mode modes[] = { HUGE_OFF, HUGE_THP, HUGE_HUGETLB };
+	int *probe = (int*) malloc(BENCH_LOOKUPS * sizeof(*probe));
+	int *a = NULL;
+	int fd[TLB_CTR_COUNT];
+	long long val[TLB_CTR_COUNT];
+	hbint_heap h = {0};
+	huge_stats st;
+	eyt_index idx;
+	bst_pool bulk;
+	size_t found = 0;
+	size_t i = 0;
+	size_t m = 0;
+	long thp = 0;
+	int v = 0;
+	double t = 0;
+
+	if(NULL == probe)
+		return;
+	tlb_open(fd);
+	for(m = 0; m < (sizeof(modes) / sizeof(modes[0])); m++)
+	{
+		huge_set_mode(modes[m]);
+		a = (int*) huge_alloc(n * sizeof(*a));
+		if(NULL == a)
+			break;
+
+		/* Heap: random keys in, all out */
+		fill(a, n, DIST_RANDOM);
+		tlb_start(fd);
+		t = now_sec();
+		for(i = 0; i < n; i++)
+			hbint_heap_push(&h, a[i]);
+		thp = anon_huge_mb();
+		while(TRUE == hbint_heap_pop(&h, &v))
+			;
+		t = now_sec() - t;
+		tlb_stop(fd, val);
+		huge_line("heap", n, t, val, thp);
+		hbint_heap_free(&h);
+
+		/* Radix sort, scratch from huge_alloc() */
+		fill(a, n, DIST_RANDOM);
+		tlb_start(fd);
+		t = now_sec();
+		radix_sort(a, n);
+		t = now_sec() - t;
+		tlb_stop(fd, val);
+		huge_line("radix", n, t, val, anon_huge_mb());
+
+		/* a is sorted now: lookups through the tree and the index */
+		for(i = 0; i < BENCH_LOOKUPS; i++)
+			probe[i] = a[rand() % n];
+		if(TRUE == bst_bulk_load(&bulk, a, n, 0))
+		{
+			found = 0;
+			tlb_start(fd);
+			t = now_sec();
+			for(i = 0; i < BENCH_LOOKUPS; i++)
+				found += (NULL != find_node(bulk.root, probe[i]));
+			t = now_sec() - t;
+			tlb_stop(fd, val);
+			huge_line("find_node", BENCH_LOOKUPS, t, val, anon_huge_mb());
+			bst_bulk_free(&bulk);
+		}
+		if(TRUE == eyt_build(&idx, a, n))
+		{
+			found = 0;
+			tlb_start(fd);
+			t = now_sec();
+			for(i = 0; i < BENCH_LOOKUPS; i++)
+				found += eyt_find(&idx, probe[i]);
+			t = now_sec() - t;
+			tlb_stop(fd, val);
+			huge_line("eyt_find", BENCH_LOOKUPS, t, val, anon_huge_mb());
+			eyt_free(&idx);
+		}
+		huge_free(a, n * sizeof(*a));
+	}
+
+	huge_get_stats(&st);
+	printf("huge_alloc: %zu MB hugetlb, %zu MB thp, %zu MB base, %zu hugetlb fallbacks\n",
+	       st.hugetlb >> 20, st.thp >> 20, st.base >> 20, st.fallbacks);
+	for(i = 0; i < TLB_CTR_COUNT; i++)
+	{
+		if(fd[i] >= 0)
+			close(fd[i]);
+	}
+	free(probe);
+}
+
+/**
+	\brief struct stable_rec: record for the stability check, seq is its
+	       input position
+*/
+typedef struct stable_rec
+{
+	int key;
+	uint32_t seq;
+}stable_rec;
+
+/*!*******************************************************
+*	\fn check_stable(const stable_rec *r, size_t n)
+*	\brief - verify ascending keys, and ascending input positions
+*		 within every run of equal keys
+*	\param r - records
+*	\param n - number of records
+*	\return bool - TRUE if sorted and stable
+*********************************************************/
+static bool check_stable(const stable_rec *r, size_t n)
+{
+	size_t i = 0;
+	for(i = 1; i < n; i++)
+	{
+		if((r[i - 1].key > r[i].key) ||
+		   ((r[i - 1].key == r[i].key) && (r[i - 1].seq > r[i].seq)))
+			return (FALSE);
+	}
+	return (TRUE);
+}
+
+/*!*******************************************************
+*	\fn bench_stable(size_t n)
+*	\brief - stable_sort_records() on every distribution, checked for
+*		 order within equal keys (few-unique is the one that
+*		 matters), against the unstable heapsort of the keys alone
+*	\param n - number of records
+*	\return void
+*********************************************************/
+static void bench_stable(size_t n)
+{
+	stable_rec *r = (stable_rec*) malloc(n * sizeof(*r));
+	int *a = (int*) malloc(n * sizeof(*a));
+	bool ok = FALSE;
+	double t = 0;
+	size_t i = 0;
+	int d = 0;
+
+	if((NULL == r) || (NULL == a))
+	{
+		free(r);
+		free(a);
+		return;
+	}
+	for(d = 0; d < DIST_COUNT; d++)
+	{
+		fill(a, n, (dist) d);
+		for(i = 0; i < n; i++)
+		{
+			r[i].key = a[i];
+			r[i].seq = (uint32_t) i;
+		}
+
+		t = now_sec();
+		bint_heapsort(a, n);
+		report("heapsort", (dist) d, n, now_sec() - t, check_sorted(a, n));
+
+		t = now_sec();
+		ok = stable_sort_records(r, n, sizeof(*r), offsetof(stable_rec, key));
+		t = now_sec() - t;
+		printf("%-18s %-14s %10zu %10.3f ms %8.1f Mel/s %s\n", "stable_records", dist_name[d],
+		       n, t * 1e3, (n / t) * 1e-6,
+		       (FALSE == ok) ? "FAILED" : ((TRUE == check_stable(r, n)) ? "" : "NOT STABLE"));
+	}
+	free(r);
+	free(a);
+}
+
+/*!*************************************************************************
+	\fn main
+	\brief - run the benchmarks
+****************************************************************************/
+int main(int argc, char **argv)
+{
+	size_t n = BENCH_DEFAULT_N;
+	const char *which = (argc > 2) ? argv[2] : NULL;
+
+	if(argc > 1)
+		n = strtoul(argv[1], NULL, 0);
+	srand(1);
+
+	if((NULL == which) || (0 == strcmp(which, "adaptive")))
+		bench_adaptive(n);
+	if((NULL == which) || (0 == strcmp(which, "small")))
+		bench_small(n);
+	if((NULL == which) || (0 == strcmp(which, "hybrid")))
+		bench_hybrid(n);
+	if((NULL == which) || (0 == strcmp(which, "lookup")))
+		bench_lookup(n);
+	if((NULL == which) || (0 == strcmp(which, "snap")))
+		bench_snap(n);
+	if((NULL == which) || (0 == strcmp(which, "cbst")))
+		bench_cbst(n);
+	if((NULL == which) || (0 == strcmp(which, "lflist")))
+		bench_lflist();
+	if((NULL == which) || (0 == strcmp(which, "timer")))
+		bench_timer();
+	if((NULL == which) || (0 == strcmp(which, "huge")))
+		bench_huge(n);
+	if((NULL == which) || (0 == strcmp(which, "stable")))
+		bench_stable(n);
+	return 0;
+}
@@ -0,0 +1,191 @@
+/**
+* @file bst_bulk.c
+* @brief O(n) construction of a perfectly balanced binary search tree from
+*        sorted data. All nodes come from one allocation; the node for
+*        sorted[i] is pool[i], so the middle of every range becomes the
+*        subtree root and the parent/size fields fall out of the recursion.
+*/
+
+#include <limits.h>
+#include <pthread.h>
+#include "heapsort.h"
+#include "hugemem.h"
+
+/** Ranges smaller than this are never handed to another thread */
+#define BULK_MIN_PARALLEL	(1 << 16)
+
+/**
+	\brief struct bulk_job: one subtree to build
+*/
+typedef struct bulk_job
+{
+	node *pool;
+	const int *sorted;
+	size_t lo;
+	size_t hi;
+	node *parent;
+	/** Extra threads this job may still start */
+	int threads;
+	/** Built subtree root */
+	node *root;
+}bulk_job;
+
+static void* bulk_build_job(void *arg);
+
+/*!****************************************************************************
+*	\fn bulk_build(node *pool, const int *sorted, size_t lo, size_t hi, node *parent, int threads)
+*	\brief - build the subtree for sorted[lo..hi)
+*	\param pool - node storage, pool[i] holds sorted[i]
+*	\param sorted - ascending keys
+*	\param lo - first index
+*	\param hi - one past the last index
+*	\param parent - parent of the subtree root
+*	\param threads - extra threads this subtree may use
+*	\return node * - subtree root, NULL for an empty range
+*	\note FUNCTION IS RECURSIVE
+******************************************************************************/
+static node* bulk_build(node *pool, const int *sorted, size_t lo, size_t hi, node *parent, int threads)
+{
+	size_t mid = lo + ((hi - lo) / 2);
+	node *n = NULL;
+	bulk_job left;
+	pthread_t tid;
+	bool spawned = FALSE;
+
+	if(lo >= hi)
+		return (NULL);
+
+	n = &pool[mid];
+	n->data = sorted[mid];
+	n->parent = parent;
+	n->size = (unsigned int)(hi - lo);
+
+	/* Left half on a new thread, right half here; each side gets half of
+	   the remaining thread budget */
+	left.pool = pool;
+	left.sorted = sorted;
+	left.lo = lo;
+	left.hi = mid;
+	left.parent = n;
+	left.threads = (threads - 1) / 2;
+	if((threads > 0) && ((hi - lo) >= BULK_MIN_PARALLEL))
+		spawned = (0 == pthread_create(&tid, NULL, bulk_build_job, &left)) ? TRUE : FALSE;
+	if(FALSE == spawned)
+	{
+		left.threads = threads / 2;
+		bulk_build_job(&left);
+	}
+
+	n->link[RIGHT] = bulk_build(pool, sorted, mid + 1, hi, n,
+				    (TRUE == spawned) ? (threads - 1 - left.threads) : (threads - left.threads));
+
+	if(TRUE == spawned)
+		pthread_join(tid, NULL);
+	n->link[LEFT] = left.root;
+	return (n);
+}
+
+/*!****************************************************************************
+*	\fn bulk_build_job(void *arg)
+*	\brief - thread entry, builds the subtree described by a bulk_job
+*	\param arg - bulk_job
+*	\return NULL
+******************************************************************************/
+static void* bulk_build_job(void *arg)
+{
+	bulk_job *job = (bulk_job*) arg;
+	job->root = bulk_build(job->pool, job->sorted, job->lo, job->hi, job->parent, job->threads);
+	return (NULL);
+}
+
+/*!****************************************************************************
+*	\fn bst_bulk_load(bst_pool *bp, const int *sorted, size_t n, int threads)
+*	\brief - build a perfectly balanced tree from ascending keys in O(n)
+*	\param bp - out: the tree and its node pool
+*	\param sorted - ascending keys
+*	\param n - number of keys, 0 gives an empty tree
+*	\param threads - extra threads to build disjoint subtrees with, 0 for none
+*	\return bool - FALSE if n is above UINT_MAX or out of memory
+******************************************************************************/
+bool bst_bulk_load(bst_pool *bp, const int *sorted, size_t n, int threads)
+{
+	bp->root = bp->pool = NULL;
+	bp->count = 0;
+	if(0 == n)
+		return (TRUE);
+	/* node.size holds the subtree sizes */
+	if(n > UINT_MAX)
+		return (FALSE);
+	bp->pool = (node*) huge_alloc(n * sizeof(*bp->pool));
+	if(NULL == bp->pool)
+		return (FALSE);
+	bp->count = n;
+	bp->root = bulk_build(bp->pool, sorted, 0, n, NULL, threads);
+	return (TRUE);
+}
+
+/*!****************************************************************************
+*	\fn bst_bulk_load_list(bst_pool *bp, node *head, int threads)
+*	\brief - bst_bulk_load() from a list built by llist.c. insert_node()
+*		 keeps the list in descending order, append_link_node() in
+*		 whatever order it was given; both are handled.
+*	\param bp - out: the tree and its node pool
+*	\param head - list head, the list is left as it is
+*	\param threads - extra threads to build disjoint subtrees with, 0 for none
+*	\return bool - FALSE if the list is unsorted or out of memory
+******************************************************************************/
+bool bst_bulk_load_list(bst_pool *bp, node *head, int threads)
+{
+	node *iter = head;
+	bool ok = FALSE;
+	int *sorted = NULL;
+	size_t n = 0;
+	size_t i = 0;
+	int t = 0;
+
+	bp->root = bp->pool = NULL;
+	bp->count = 0;
+	for(iter = head; NULL != iter; iter = iter->link[NEXT])
+		n++;
+	if(0 == n)
+		return (TRUE);
+	sorted = (int*) malloc(n * sizeof(*sorted));
+	if(NULL == sorted)
+		return (FALSE);
+	for(iter = head, i = 0; NULL != iter; iter = iter->link[NEXT])
+		sorted[i++] = iter->data;
+
+	if(sorted[0] > sorted[n - 1])
+	{
+		for(i = 0; i < (n / 2); i++)
+		{
+			t = sorted[i]; sorted[i] = sorted[n - 1 - i]; sorted[n - 1 - i] = t;
+		}
+	}
+	for(i = 1; i < n; i++)
+	{
+		if(sorted[i - 1] > sorted[i])
+		{
+			PRINT("bst_bulk_load_list: list is not sorted at %zu\n", i);
+			free(sorted);
+			return (FALSE);
+		}
+	}
+
+	ok = bst_bulk_load(bp, sorted, n, threads);
+	free(sorted);
+	return (ok);
+}
+
+/*!****************************************************************************
+*	\fn bst_bulk_free(bst_pool *bp)
+*	\brief - free a tree built by bst_bulk_load() and empty bp
+*	\param bp - tree and node pool
+*	\return void
+******************************************************************************/
+void bst_bulk_free(bst_pool *bp)
+{
+	huge_free(bp->pool, bp->count * sizeof(*bp->pool));
+	bp->root = bp->pool = NULL;
+	bp->count = 0;
+}
@@ -0,0 +1,120 @@
+/**
+* @file bst_iter.c
+* @brief Stackless in-order iteration over the binary search tree. A node
+*        handle is the iterator: the successor and predecessor are found
+*        through the parent links, so there is no recursion, no stack and
+*        no copy of the keys.
+*/
+
+#include "heapsort.h"
+
+/*!****************************************************************************
+*	\fn bst_first(node *root)
+*	\brief - Smallest key of the tree
+*	\param root - tree root
+*	\return - node * - leftmost node, NULL if the tree is empty
+******************************************************************************/
+node* bst_first(node *root)
+{
+	while((NULL != root) && (NULL != root->link[LEFT]))
+		root = root->link[LEFT];
+	return (root);
+}
+
+/*!****************************************************************************
+*	\fn bst_last(node *root)
+*	\brief - Largest key of the tree
+*	\param root - tree root
+*	\return - node * - rightmost node, NULL if the tree is empty
+******************************************************************************/
+node* bst_last(node *root)
+{
+	while((NULL != root) && (NULL != root->link[RIGHT]))
+		root = root->link[RIGHT];
+	return (root);
+}
+
+/*!****************************************************************************
+*	\fn bst_lower_bound(node *root, int data)
+*	\brief - Seek to the first key >= data
+*	\param root - tree root
+*	\param data - key to seek to
+*	\return - node * - first node not smaller than data, NULL if none
+******************************************************************************/
+node* bst_lower_bound(node *root, int data)
+{
+	node *cand = NULL;
+	while(NULL != root)
+	{
+		if(root->data >= data)
+		{
+			/* Could be it, but something smaller may still qualify */
+			cand = root;
+			root = root->link[LEFT];
+		}
+		else
+			root = root->link[RIGHT];
+	}
+	return (cand);
+}
+
+/*!****************************************************************************
+*	\fn bst_next(node *n)
+*	\brief - In-order successor, amortized O(1) over a full scan
+*	\param n - current node
+*	\return - node * - next node, NULL after the last one
+******************************************************************************/
+node* bst_next(node *n)
+{
+	if(NULL == n)
+		return (NULL);
+	if(NULL != n->link[RIGHT])
+		return (bst_first(n->link[RIGHT]));
+	/* Climb until we come up from a left child */
+	while((NULL != n->parent) && (n->parent->link[RIGHT] == n))
+		n = n->parent;
+	return (n->parent);
+}
+
+/*!****************************************************************************
+*	\fn bst_prev(node *n)
+*	\brief - In-order predecessor
+*	\param n - current node
+*	\return - node * - previous node, NULL before the first one
+******************************************************************************/
+node* bst_prev(node *n)
+{
+	if(NULL == n)
+		return (NULL);
+	if(NULL != n->link[LEFT])
+		return (bst_last(n->link[LEFT]));
+	/* Climb until we come up from a right child */
+	while((NULL != n->parent) && (n->parent->link[LEFT] == n))
+		n = n->parent;
+	return (n->parent);
+}
+
+/*!****************************************************************************
+*	\fn bst_range_scan(node *root, int lo, int hi, emit_fn emit, void *ctx)
+*	\brief - Stream every key in [lo, hi] to emit() in ascending order,
+*		  without recursion
+*	\param root - tree root
+*	\param lo - lower bound, inclusive
+*	\param hi - upper bound, inclusive
+*	\param emit - called for every key in range
+*	\param ctx - passed through to emit
+*	\return - size_t - number of keys emitted
+******************************************************************************/
+size_t bst_range_scan(node *root, int lo, int hi, emit_fn emit, void *ctx)
+{
+	size_t cnt = 0;
+	node *n = bst_lower_bound(root, lo);
+
+	while((NULL != n) && (n->data <= hi))
+	{
+		emit(n->data, ctx);
+		cnt++;
+		n = bst_next(n);
+	}
+	return (cnt);
+}
@@ -0,0 +1,168 @@
+/**
+* @file bst_stats.c
+* @brief Order statistics on the binary tree: rank, select, percentile and
+*        range queries using the subtree sizes kept in node.size.
+*
+*        Every query walks one root to leaf path, so it costs O(height).
+*        That is O(log n) for trees from bst_bulk_load() and for the cbst,
+*        but add_node() + balance_tree() only rotate at the root, and sorted
+*        input still gives those trees linear height.
+*/
+
+#include "heapsort.h"
+
+/*!****************************************************************************
+*	\fn bst_rank_le(node *root, int data)
+*	\brief - Number of keys in the tree smaller than or equal to data,
+*		  O(height)
+*	\param root - tree root
+*	\param data - key to rank
+*	\return - size_t - count of keys <= data
+******************************************************************************/
+static size_t bst_rank_le(node *root, int data)
+{
+	size_t rank = 0;
+	while(NULL != root)
+	{
+		if(root->data <= data)
+		{
+			/* This node and everything on its left count */
+			rank += NODE_SIZE(root->link[LEFT]) + 1;
+			root = root->link[RIGHT];
+		}
+		else
+			root = root->link[LEFT];
+	}
+	return (rank);
+}
+
+/*!****************************************************************************
+*	\fn bst_rank(node *root, int data)
+*	\brief - Number of keys in the tree smaller than data, O(height)
+*	\param root - tree root
+*	\param data - key to rank
+*	\return - size_t - count of keys < data
+******************************************************************************/
+size_t bst_rank(node *root, int data)
+{
+	size_t rank = 0;
+	while(NULL != root)
+	{
+		if(root->data < data)
+		{
+			rank += NODE_SIZE(root->link[LEFT]) + 1;
+			root = root->link[RIGHT];
+		}
+		else
+			root = root->link[LEFT];
+	}
+	return (rank);
+}
+
+/*!****************************************************************************
+*	\fn bst_select(node *root, size_t k)
+*	\brief - Find the k-th smallest key, O(height)
+*	\param root - tree root
+*	\param k - 0 based rank
+*	\return - node * - node holding it, NULL if k is out of range
+******************************************************************************/
+node* bst_select(node *root, size_t k)
+{
+	size_t left = 0;
+	while(NULL != root)
+	{
+		left = NODE_SIZE(root->link[LEFT]);
+		if(k < left)
+			root = root->link[LEFT];
+		else if(k == left)
+			break;
+		else
+		{
+			k -= left + 1;
+			root = root->link[RIGHT];
+		}
+	}
+	return (root);
+}
+
+/*!****************************************************************************
+*	\fn bst_percentile(node *root, double p)
+*	\brief - Nearest rank percentile, e.g. p = 99 gives the p99 value,
+*		  O(height)
+*	\param root - tree root
+*	\param p - percentile, 0 to 100
+*	\return - node * - node holding it, NULL if the tree is empty
+******************************************************************************/
+node* bst_percentile(node *root, double p)
+{
+	size_t n = NODE_SIZE(root);
+	double pos = 0;
+	size_t k = 0;
+
+	if(0 == n)
+		return (NULL);
+	/* Out of range p would make pos negative (undefined to convert) or
+	   past the end; NaN fails both tests and is taken as 0 */
+	if(!(p > 0))
+		p = 0;
+	else if(p > 100)
+		p = 100;
+	pos = (p / 100.0) * n;
+	k = (size_t) pos;
+	/* Nearest rank is ceil(p * n), 1 based */
+	if((double) k < pos)
+		k++;
+	k = (0 == k) ? 0 : (k - 1);
+	if(k >= n)
+		k = n - 1;
+	return (bst_select(root, k));
+}
+
+/*!****************************************************************************
+*	\fn bst_range_count(node *root, int lo, int hi)
+*	\brief - Number of keys in [lo, hi], O(height)
+*	\param root - tree root
+*	\param lo - lower bound, inclusive
+*	\param hi - upper bound, inclusive
+*	\return - size_t - count
+******************************************************************************/
+size_t bst_range_count(node *root, int lo, int hi)
+{
+	if(lo > hi)
+		return (0);
+	return (bst_rank_le(root, hi) - bst_rank(root, lo));
+}
+
+/*!****************************************************************************
+*	\fn bst_range_iter(node *root, int lo, int hi, emit_fn emit, void *ctx)
+*	\brief - Hand every key in [lo, hi] to emit() in ascending order,
+*		  O(height + m) for m matching keys
+*	\param root - tree root
+*	\param lo - lower bound, inclusive
+*	\param hi - upper bound, inclusive
+*	\param emit - called for every key in range
+*	\param ctx - passed through to emit
+*	\return - size_t - number of keys emitted
+*	\note FUNCTION IS RECURSIVE
+******************************************************************************/
+size_t bst_range_iter(node *root, int lo, int hi, emit_fn emit, void *ctx)
+{
+	size_t cnt = 0;
+	if(NULL == root)
+		return (0);
+
+	/* Keys equal to this one may sit on the left (DIR() sends them there),
+	   so only skip the left subtree when it is entirely below lo */
+	if(lo <= root->data)
+		cnt += bst_range_iter(root->link[LEFT], lo, hi, emit, ctx);
+	if((lo <= root->data) && (root->data <= hi))
+	{
+		emit(root->data, ctx);
+		cnt++;
+	}
+	/* Everything on the right is at least this key (a rotation can move an
+	   equal key to the right) */
+	if(root->data <= hi)
+		cnt += bst_range_iter(root->link[RIGHT], lo, hi, emit, ctx);
+	return (cnt);
+}
@@ -0,0 +1,291 @@
+/**
+* @file cbst.c
+* @brief Path copying insert, scapegoat rebuild and epoch reclamation for
+*        the concurrent tree
+*/
+
+#include "cbst.h"
+
+/*!*******************************************************
+*	\fn node_free(void *p)
+*	\brief - epoch_free_fn for tree nodes
+*	\param p - node
+*	\return void
+*********************************************************/
+static void node_free(void *p)
+{
+	free(p);
+}
+
+/*!*******************************************************
+*	\fn cbst_init(cbst *t, int max_threads)
+*	\brief - set up an empty tree
+*	\param t - tree
+*	\param max_threads - readers plus writers that will register
+*	\return bool - FALSE if out of memory
+*********************************************************/
+bool cbst_init(cbst *t, int max_threads)
+{
+	atomic_init(&t->root, NULL);
+	if(0 != pthread_mutex_init(&t->wlock, NULL))
+		return (FALSE);
+	return (epoch_init(&t->ep, max_threads, node_free));
+}
+
+/*!*******************************************************
+*	\fn cbst_register(cbst *t)
+*	\brief - register the calling thread
+*	\param t - tree
+*	\return int - thread id for the other calls, -1 if too many threads
+*********************************************************/
+int cbst_register(cbst *t)
+{
+	return (epoch_register(&t->ep));
+}
+
+/*!*******************************************************
+*	\fn cbst_find(cbst *t, int tid, int data)
+*	\brief - find_node() on the current version
+*	\param t - tree
+*	\param tid - id from cbst_register()
+*	\param data - key to look for
+*	\return bool - TRUE if present
+*********************************************************/
+bool cbst_find(cbst *t, int tid, int data)
+{
+	node *root = cbst_read_begin(t, tid);
+	bool found = (NULL != find_node(root, data)) ? TRUE : FALSE;
+	cbst_read_end(t, tid);
+	return (found);
+}
+
+/*!*******************************************************
+*	\fn alpha_height(size_t n)
+*	\brief - deepest a leaf may sit in an alpha balanced tree of n nodes,
+*		 log base 1/alpha of n
+*	\param n - tree size
+*	\return size_t - depth bound (root is depth 0)
+*********************************************************/
+static size_t alpha_height(size_t n)
+{
+	size_t h = 0;
+	while(n > 1)
+	{
+		n = (n * CBST_ALPHA_NUM) / CBST_ALPHA_DEN;
+		h++;
+	}
+	return (h);
+}
+
+/*!*******************************************************
+*	\fn flatten(node *root, node **out, size_t pos)
+*	\brief - in-order list of the subtree's nodes
+*	\param root - subtree root
+*	\param out - output array
+*	\param pos - where the smallest node goes
+*	\return size_t - position after the largest node
+*	\note FUNCTION IS RECURSIVE
+*********************************************************/
+static size_t flatten(node *root, node **out, size_t pos)
+{
+	if(NULL != root)
+	{
+		pos = flatten(root->link[LEFT], out, pos);
+		out[pos++] = root;
+		pos = flatten(root->link[RIGHT], out, pos);
+	}
+	return (pos);
+}
+
+/*!*******************************************************
+*	\fn build_balanced(const int *keys, size_t lo, size_t hi, node **fresh)
+*	\brief - perfectly balanced subtree for keys[lo..hi) out of
+*		 preallocated nodes
+*	\param keys - ascending keys
+*	\param lo - first index
+*	\param hi - one past the last index
+*	\param fresh - unused nodes, one per key, consumed from the front
+*	\return node * - subtree root
+*	\note FUNCTION IS RECURSIVE
+*********************************************************/
+static node* build_balanced(const int *keys, size_t lo, size_t hi, node ***fresh)
+{
+	size_t mid = lo + ((hi - lo) / 2);
+	node *n = NULL;
+
+	if(lo >= hi)
+		return (NULL);
+	n = *(*fresh)++;
+	n->data = keys[mid];
+	n->parent = NULL;
+	n->size = (unsigned int)(hi - lo);
+	n->link[LEFT] = build_balanced(keys, lo, mid, fresh);
+	n->link[RIGHT] = build_balanced(keys, mid + 1, hi, fresh);
+	return (n);
+}
+
+/*!*******************************************************
+*	\fn cbst_insert(cbst *t, int tid, int data)
+*	\brief - add_node() for the concurrent tree, readers keep running
+*	\param t - tree
+*	\param tid - id from cbst_register()
+*	\param data - key to add
+*	\return bool - FALSE if out of memory (tree unchanged)
+*********************************************************/
+bool cbst_insert(cbst *t, int tid, int data)
+{
+	node *path[CBST_MAX_DEPTH];
+	node *copy[CBST_MAX_DEPTH + 1];
+	node *root = NULL;
+	node **old = NULL;
+	node **fresh = NULL;
+	node **cursor = NULL;
+	int *keys = NULL;
+	node *n = NULL;
+	size_t depth = 0;
+	size_t goat = 0;
+	size_t cnt = 0;
+	size_t i = 0;
+	size_t j = 0;
+	bool rebuild = FALSE;
+	bool placed = FALSE;
+
+	pthread_mutex_lock(&t->wlock);
+
+	/* Same walk as add_node(): equal keys go left */
+	for(n = atomic_load_explicit(&t->root, memory_order_relaxed); NULL != n; n = n->link[DIR(data, n->data)])
+	{
+		if(CBST_MAX_DEPTH == depth)
+		{
+			pthread_mutex_unlock(&t->wlock);
+			return (FALSE);
+		}
+		path[depth++] = n;
+	}
+
+	/* Copy the path bottom up; copy[depth] is the new leaf. Everything off
+	   the path is shared with the published version. */
+	for(i = 0; i <= depth; i++)
+	{
+		copy[i] = new();
+		if(NULL == copy[i])
+		{
+			while(i-- > 0)
+				free(copy[i]);
+			pthread_mutex_unlock(&t->wlock);
+			return (FALSE);
+		}
+	}
+	copy[depth]->data = data;
+	copy[depth]->parent = NULL;
+	copy[depth]->size = 1;
+	for(i = depth; i-- > 0; )
+	{
+		*copy[i] = *path[i];
+		copy[i]->parent = NULL;
+		copy[i]->size++;
+		copy[i]->link[DIR(data, path[i]->data)] = copy[i + 1];
+	}
+
+	/* Leaf too deep: rebuild the highest subtree on the path where one
+	   child outweighs alpha of the whole */
+	if(depth > alpha_height(copy[0]->size))
+	{
+		for(i = 0; (i < depth) && (FALSE == rebuild); i++)
+		{
+			if((copy[i + 1]->size * CBST_ALPHA_DEN) > (copy[i]->size * CBST_ALPHA_NUM))
+			{
+				goat = i;
+				rebuild = TRUE;
+			}
+		}
+	}
+
+	if(TRUE == rebuild)
+	{
+		/* The rebuilt subtree holds the old subtree's keys plus the new one */
+		cnt = path[goat]->size + 1;
+		old = (node**) malloc(cnt * sizeof(*old));
+		fresh = (node**) malloc(cnt * sizeof(*fresh));
+		keys = (int*) malloc(cnt * sizeof(*keys));
+		for(j = 0; (NULL != fresh) && (j < cnt); j++)
+		{
+			fresh[j] = new();
+			if(NULL == fresh[j])
+				break;
+		}
+		if((NULL == old) || (NULL == fresh) || (NULL == keys) || (j < cnt))
+		{
+			/* Skip the rebuild, the plain path copy is still correct */
+			while((NULL != fresh) && (j-- > 0))
+				free(fresh[j]);
+			free(old);
+			free(fresh);
+			free(keys);
+			old = fresh = NULL;
+			keys = NULL;
+			rebuild = FALSE;
+		}
+		else
+		{
+			/* In-order keys of the old subtree with the new key merged in */
+			flatten(path[goat], old, 0);
+			for(i = 0, j = 0; j < cnt; j++)
+			{
+				if((FALSE == placed) && ((i == (cnt - 1)) || (data <= old[i]->data)))
+				{
+					keys[j] = data;
+					placed = TRUE;
+				}
+				else
+					keys[j] = old[i++]->data;
+			}
+			cursor = fresh;
+			n = build_balanced(keys, 0, cnt, &cursor);
+			if(0 == goat)
+				root = n;
+			else
+				copy[goat - 1]->link[(copy[goat - 1]->link[LEFT] == copy[goat]) ? LEFT : RIGHT] = n;
+		}
+	}
+
+	atomic_store_explicit(&t->root, (NULL != root) ? root : copy[0], memory_order_release);
+
+	/* Readers may still be walking the replaced nodes, retire them */
+	if(TRUE == rebuild)
+	{
+		for(i = 0; i < goat; i++)
+			epoch_retire(&t->ep, tid, path[i]);
+		for(j = 0; j < (cnt - 1); j++)
+			epoch_retire(&t->ep, tid, old[j]);
+		/* Copies from the scapegoat down were never published */
+		for(i = goat; i <= depth; i++)
+			free(copy[i]);
+		free(old);
+		free(fresh);
+		free(keys);
+	}
+	else
+	{
+		for(i = 0; i < depth; i++)
+			epoch_retire(&t->ep, tid, path[i]);
+	}
+
+	pthread_mutex_unlock(&t->wlock);
+	return (TRUE);
+}
+
+/*!*******************************************************
+*	\fn cbst_free(cbst *t)
+*	\brief - free the tree and everything retired. No thread may be
+*		 using it any more.
+*	\param t - tree
+*	\return void
+*********************************************************/
+void cbst_free(cbst *t)
+{
+	free_tree(atomic_load(&t->root));
+	atomic_store(&t->root, NULL);
+	epoch_destroy(&t->ep);
+	pthread_mutex_destroy(&t->wlock);
+}
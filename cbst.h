@@ -0,0 +1,118 @@
+/**
+* @file cbst.h
+* @brief Concurrent binary search tree for many readers and one writer.
+*        The writer never changes a node that is already published: an
+*        insert copies the path from the root down to the new leaf and
+*        publishes the new root with a single atomic store. Readers take a
+*        snapshot of the root and search it with the ordinary read-only
+*        functions (find_node(), bst_rank(), bst_select(), ...) without
+*        taking a lock or writing anything but their own epoch slot.
+*        Replaced nodes are freed through epoch.h once no reader can see them.
+*
+*        The tree is kept balanced scapegoat style: when an insert lands too
+*        deep, the path is scanned from the root down and the first (so the
+*        largest) unbalanced subtree on it is rebuilt, which fits path
+*        copying since the rebuilt subtree is new anyway.
+*/
+
+#ifndef _CBST_H_
+#define _CBST_H_
+
+#include <pthread.h>
+#include "epoch.h"
+
+/** Balance factor alpha = CBST_ALPHA_NUM / CBST_ALPHA_DEN: a child may
+    hold at most this fraction of its parent's subtree */
+#define CBST_ALPHA_NUM		(3)
+#define CBST_ALPHA_DEN		(4)
+
+/** Deepest path an insert can walk; alpha = 3/4 keeps the height under
+    2.5 * log2(n) + 2 */
+#define CBST_MAX_DEPTH		(96)
+
+/**
+	\brief struct cbst: shared tree handle
+*/
+typedef struct cbst
+{
+	/** Current version of the tree, swapped atomically by the writer */
+	_Alignas(64) _Atomic(node*) root;
+	/** Serializes writers, readers never touch it */
+	_Alignas(64) pthread_mutex_t wlock;
+	epoch_domain ep;
+}cbst;
+
+/*!*******************************************************
+*	\fn cbst_init(cbst *t, int max_threads)
+*	\brief - set up an empty tree
+*	\param t - tree
+*	\param max_threads - readers plus writers that will register
+*	\return bool - FALSE if out of memory
+*********************************************************/
+bool cbst_init(cbst *t, int max_threads);
+
+/*!*******************************************************
+*	\fn cbst_register(cbst *t)
+*	\brief - register the calling thread
+*	\param t - tree
+*	\return int - thread id for the other calls, -1 if too many threads
+*********************************************************/
+int cbst_register(cbst *t);
+
+/*!*******************************************************
+*	\fn cbst_read_begin(cbst *t, int tid)
+*	\brief - take a snapshot of the tree. The nodes stay valid and
+*		 unchanged until cbst_read_end(). Parent links are not kept
+*		 in a copied tree, so bst_next()/bst_prev() can't be used.
+*	\param t - tree
+*	\param tid - id from cbst_register()
+*	\return node * - root of the snapshot
+*********************************************************/
+static inline node* cbst_read_begin(cbst *t, int tid)
+{
+	epoch_enter(&t->ep, tid);
+	return (atomic_load_explicit(&t->root, memory_order_acquire));
+}
+
+/*!*******************************************************
+*	\fn cbst_read_end(cbst *t, int tid)
+*	\brief - release the snapshot from cbst_read_begin()
+*	\param t - tree
+*	\param tid - id from cbst_register()
+*	\return void
+*********************************************************/
+static inline void cbst_read_end(cbst *t, int tid)
+{
+	epoch_exit(&t->ep, tid);
+}
+
+/*!*******************************************************
+*	\fn cbst_find(cbst *t, int tid, int data)
+*	\brief - find_node() on the current version
+*	\param t - tree
+*	\param tid - id from cbst_register()
+*	\param data - key to look for
+*	\return bool - TRUE if present
+*********************************************************/
+bool cbst_find(cbst *t, int tid, int data);
+
+/*!*******************************************************
+*	\fn cbst_insert(cbst *t, int tid, int data)
+*	\brief - add_node() for the concurrent tree, readers keep running
+*	\param t - tree
+*	\param tid - id from cbst_register()
+*	\param data - key to add
+*	\return bool - FALSE if out of memory (tree unchanged)
+*********************************************************/
+bool cbst_insert(cbst *t, int tid, int data);
+
+/*!*******************************************************
+*	\fn cbst_free(cbst *t)
+*	\brief - free the tree and everything retired. No thread may be
+*		 using it any more.
+*	\param t - tree
+*	\return void
+*********************************************************/
+void cbst_free(cbst *t);
+
+#endif // _CBST_H_
@@ -0,0 +1,159 @@
+/**
+* @file epoch.c
+* @brief Epoch based reclamation: retire lists, epoch advance and freeing
+*/
+
+#include "epoch.h"
+
+/*!*******************************************************
+*	\fn epoch_init(epoch_domain *dom, int max_threads, epoch_free_fn free_fn)
+*	\brief - set up a domain
+*	\param dom - domain
+*	\param max_threads - most threads that will ever register
+*	\param free_fn - frees a retired object
+*	\return bool - FALSE if out of memory
+*********************************************************/
+bool epoch_init(epoch_domain *dom, int max_threads, epoch_free_fn free_fn)
+{
+	int i = 0;
+
+	dom->slot = (epoch_slot*) aligned_alloc(_Alignof(epoch_slot), max_threads * sizeof(epoch_slot));
+	if(NULL == dom->slot)
+		return (FALSE);
+	/* Epoch 0 would look like an idle slot, start at 1 */
+	atomic_init(&dom->global, 1);
+	atomic_init(&dom->nthreads, 0);
+	dom->max_threads = max_threads;
+	dom->free_fn = free_fn;
+	for(i = 0; i < max_threads; i++)
+	{
+		atomic_init(&dom->slot[i].state, 0);
+		memset(&dom->slot[i].limbo, 0, sizeof(epoch_limbo));
+	}
+	return (TRUE);
+}
+
+/*!*******************************************************
+*	\fn epoch_register(epoch_domain *dom)
+*	\brief - claim a slot for the calling thread
+*	\param dom - domain
+*	\return int - thread id to pass to the other calls, -1 if full
+*********************************************************/
+int epoch_register(epoch_domain *dom)
+{
+	int tid = atomic_fetch_add(&dom->nthreads, 1);
+	if(tid >= dom->max_threads)
+	{
+		atomic_fetch_sub(&dom->nthreads, 1);
+		return (-1);
+	}
+	return (tid);
+}
+
+/*!*******************************************************
+*	\fn epoch_try_advance(epoch_domain *dom)
+*	\brief - bump the global epoch if every thread inside a read
+*		 section has already seen the current one
+*	\param dom - domain
+*	\return uint64_t - global epoch after the attempt
+*********************************************************/
+static uint64_t epoch_try_advance(epoch_domain *dom)
+{
+	uint64_t e = atomic_load(&dom->global);
+	uint64_t s = 0;
+	int n = atomic_load(&dom->nthreads);
+	int i = 0;
+
+	for(i = 0; i < n; i++)
+	{
+		s = atomic_load(&dom->slot[i].state);
+		if((0 != (s & EPOCH_ACTIVE)) && ((s >> 1) != e))
+			return (e);
+	}
+	/* Losing the race is fine, someone else advanced it */
+	atomic_compare_exchange_strong(&dom->global, &e, e + 1);
+	return (atomic_load(&dom->global));
+}
+
+/*!*******************************************************
+*	\fn epoch_retire(epoch_domain *dom, int tid, void *p)
+*	\brief - hand over an object that is no longer reachable from the
+*		 shared structure; it is freed once no reader can hold it
+*	\param dom - domain
+*	\param tid - id from epoch_register()
+*	\param p - unlinked object
+*	\return void
+*********************************************************/
+void epoch_retire(epoch_domain *dom, int tid, void *p)
+{
+	epoch_limbo *l = &dom->slot[tid].limbo;
+
+	if(l->n == l->cap)
+	{
+		size_t cap = (0 == l->cap) ? (2 * EPOCH_RECLAIM_BATCH) : (2 * l->cap);
+		epoch_retired *obj = (epoch_retired*) realloc(l->obj, cap * sizeof(*obj));
+		if(NULL == obj)
+		{
+			/* Freeing it now could pull it from under a reader; leaking one
+			   object is the lesser evil */
+			PRINT("epoch_retire: out of memory, leaking %p\n", p);
+			return;
+		}
+		l->obj = obj;
+		l->cap = cap;
+	}
+	l->obj[l->n].ptr = p;
+	l->obj[l->n].tag = atomic_load(&dom->global);
+	l->n++;
+
+	if(0 == (l->n % EPOCH_RECLAIM_BATCH))
+		epoch_reclaim(dom, tid);
+}
+
+/*!*******************************************************
+*	\fn epoch_reclaim(epoch_domain *dom, int tid)
+*	\brief - try to move the global epoch on and free whatever the
+*		 calling thread retired at least two epochs ago
+*	\param dom - domain
+*	\param tid - id from epoch_register()
+*	\return void
+*********************************************************/
+void epoch_reclaim(epoch_domain *dom, int tid)
+{
+	epoch_limbo *l = &dom->slot[tid].limbo;
+	uint64_t e = epoch_try_advance(dom);
+	size_t keep = 0;
+	size_t i = 0;
+
+	for(i = 0; i < l->n; i++)
+	{
+		if((l->obj[i].tag + 2) <= e)
+			dom->free_fn(l->obj[i].ptr);
+		else
+			l->obj[keep++] = l->obj[i];
+	}
+	l->n = keep;
+}
+
+/*!*******************************************************
+*	\fn epoch_destroy(epoch_domain *dom)
+*	\brief - free everything still retired and the domain itself. No
+*		 thread may be using the domain any more.
+*	\param dom - domain
+*	\return void
+*********************************************************/
+void epoch_destroy(epoch_domain *dom)
+{
+	int i = 0;
+	size_t j = 0;
+
+	for(i = 0; i < dom->max_threads; i++)
+	{
+		epoch_limbo *l = &dom->slot[i].limbo;
+		for(j = 0; j < l->n; j++)
+			dom->free_fn(l->obj[j].ptr);
+		free(l->obj);
+	}
+	free(dom->slot);
+	dom->slot = NULL;
+}
@@ -0,0 +1,146 @@
+/**
+* @file epoch.h
+* @brief Epoch based reclamation for the concurrent structures. Readers
+*        announce the global epoch in their own cache line while they hold
+*        references; memory unlinked by a writer is only freed once every
+*        active thread has been seen in a later epoch, i.e. two epochs on.
+*/
+
+#ifndef _EPOCH_H_
+#define _EPOCH_H_
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "heapsort.h"
+
+/** Slot state bit set while a thread is inside a read section */
+#define EPOCH_ACTIVE		(1)
+
+/** Retired objects a thread collects before it tries to free some */
+#define EPOCH_RECLAIM_BATCH	(64)
+
+/** Called to free a retired object */
+typedef void (*epoch_free_fn) (void *p);
+
+/**
+	\brief struct epoch_retired: one object waiting to be freed
+*/
+typedef struct epoch_retired
+{
+	void *ptr;
+	/** Global epoch at the time it was retired */
+	uint64_t tag;
+}epoch_retired;
+
+/**
+	\brief struct epoch_limbo: objects retired by one thread, not yet freed
+*/
+typedef struct epoch_limbo
+{
+	epoch_retired *obj;
+	size_t n;
+	size_t cap;
+}epoch_limbo;
+
+/**
+	\brief struct epoch_slot: per thread state, one cache line each so a
+	       reader entering or leaving only ever writes its own line
+*/
+typedef struct epoch_slot
+{
+	/** (epoch << 1) | EPOCH_ACTIVE while in a read section, 0 otherwise */
+	_Alignas(64) _Atomic uint64_t state;
+	/** Only touched by the owning thread */
+	epoch_limbo limbo;
+}epoch_slot;
+
+/**
+	\brief struct epoch_domain: one reclamation domain, shared by all the
+	       threads working on one structure
+*/
+typedef struct epoch_domain
+{
+	_Alignas(64) _Atomic uint64_t global;
+	_Alignas(64) _Atomic int nthreads;
+	int max_threads;
+	epoch_free_fn free_fn;
+	epoch_slot *slot;
+}epoch_domain;
+
+/*!*******************************************************
+*	\fn epoch_init(epoch_domain *dom, int max_threads, epoch_free_fn free_fn)
+*	\brief - set up a domain
+*	\param dom - domain
+*	\param max_threads - most threads that will ever register
+*	\param free_fn - frees a retired object
+*	\return bool - FALSE if out of memory
+*********************************************************/
+bool epoch_init(epoch_domain *dom, int max_threads, epoch_free_fn free_fn);
+
+/*!*******************************************************
+*	\fn epoch_register(epoch_domain *dom)
+*	\brief - claim a slot for the calling thread
+*	\param dom - domain
+*	\return int - thread id to pass to the other calls, -1 if full
+*********************************************************/
+int epoch_register(epoch_domain *dom);
+
+/*!*******************************************************
+*	\fn epoch_enter(epoch_domain *dom, int tid)
+*	\brief - start a read section; nothing reachable now is freed before
+*		 the matching epoch_exit()
+*	\param dom - domain
+*	\param tid - id from epoch_register()
+*	\return void
+*********************************************************/
+static inline void epoch_enter(epoch_domain *dom, int tid)
+{
+	uint64_t e = atomic_load_explicit(&dom->global, memory_order_relaxed);
+	atomic_store_explicit(&dom->slot[tid].state, (e << 1) | EPOCH_ACTIVE, memory_order_relaxed);
+	/* The announcement has to be visible before any shared pointer is read */
+	atomic_thread_fence(memory_order_seq_cst);
+}
+
+/*!*******************************************************
+*	\fn epoch_exit(epoch_domain *dom, int tid)
+*	\brief - end a read section, references taken inside it are dead
+*	\param dom - domain
+*	\param tid - id from epoch_register()
+*	\return void
+*********************************************************/
+static inline void epoch_exit(epoch_domain *dom, int tid)
+{
+	atomic_store_explicit(&dom->slot[tid].state, 0, memory_order_release);
+}
+
+/*!*******************************************************
+*	\fn epoch_retire(epoch_domain *dom, int tid, void *p)
+*	\brief - hand over an object that is no longer reachable from the
+*		 shared structure; it is freed once no reader can hold it
+*	\param dom - domain
+*	\param tid - id from epoch_register()
+*	\param p - unlinked object
+*	\return void
+*********************************************************/
+void epoch_retire(epoch_domain *dom, int tid, void *p);
+
+/*!*******************************************************
+*	\fn epoch_reclaim(epoch_domain *dom, int tid)
+*	\brief - try to move the global epoch on and free whatever the
+*		 calling thread retired at least two epochs ago
+*	\param dom - domain
+*	\param tid - id from epoch_register()
+*	\return void
+*********************************************************/
+void epoch_reclaim(epoch_domain *dom, int tid);
+
+/*!*******************************************************
+*	\fn epoch_destroy(epoch_domain *dom)
+*	\brief - free everything still retired and the domain itself. No
+*		 thread may be using the domain any more.
+*	\param dom - domain
+*	\return void
+*********************************************************/
+void epoch_destroy(epoch_domain *dom);
+
+#endif // _EPOCH_H_
@@ -0,0 +1,241 @@
+/**
+* @file eytzinger.c
+* @brief Building the Eytzinger layout from sorted data, a BST or the heap
+*/
+
+#include "eytzinger.h"
+#include "hugemem.h"
+
+/*!*******************************************************
+*	\fn eyt_alloc(eyt_index *idx, size_t n)
+*	\brief - allocate a cache line aligned key array for n keys, on huge
+*		 pages once it is big enough; every lookup walks a random
+*		 root to leaf path through it
+*	\param idx - index
+*	\param n - number of keys
+*	\return bool - FALSE if out of memory
+*********************************************************/
+static bool eyt_alloc(eyt_index *idx, size_t n)
+{
+	/* Slot 0 is unused */
+	idx->keys = (int*) huge_alloc((n + 1) * sizeof(int));
+	idx->n = (NULL == idx->keys) ? 0 : n;
+	return ((NULL == idx->keys) ? FALSE : TRUE);
+}
+
+/*!*******************************************************
+*	\fn eyt_fill(eyt_index *idx, const int *sorted, size_t *pos, size_t k)
+*	\brief - in-order walk of the implicit tree rooted at slot k,
+*		 handing out the sorted keys in turn
+*	\param idx - index being filled
+*	\param sorted - ascending keys
+*	\param pos - next key to hand out
+*	\param k - slot
+*	\return void
+*	\note FUNCTION IS RECURSIVE
+*********************************************************/
+static void eyt_fill(eyt_index *idx, const int *sorted, size_t *pos, size_t k)
+{
+	if(k <= idx->n)
+	{
+		eyt_fill(idx, sorted, pos, 2 * k);
+		idx->keys[k] = sorted[(*pos)++];
+		eyt_fill(idx, sorted, pos, (2 * k) + 1);
+	}
+}
+
+/*!*******************************************************
+*	\fn eyt_build(eyt_index *idx, const int *sorted, size_t n)
+*	\brief - lay out an ascending array in Eytzinger order
+*	\param idx - index to fill
+*	\param sorted - n keys, ascending
+*	\param n - number of keys
+*	\return bool - FALSE if out of memory
+*********************************************************/
+bool eyt_build(eyt_index *idx, const int *sorted, size_t n)
+{
+	size_t pos = 0;
+
+	if(FALSE == eyt_alloc(idx, n))
+		return (FALSE);
+	eyt_fill(idx, sorted, &pos, 1);
+	return (TRUE);
+}
+
+/*!*******************************************************
+*	\fn tree_to_array(node *root, int *out, size_t n, size_t pos)
+*	\brief - in-order copy of the tree keys. Keys past out[n - 1] are
+*		 counted but not stored, so a tree whose sizes are off
+*		 can't write past the array.
+*	\param root - subtree root
+*	\param out - output array of n keys
+*	\param n - length of out
+*	\param pos - where this subtree's smallest key goes
+*	\return size_t - position after this subtree's largest key
+*	\note FUNCTION IS RECURSIVE
+*********************************************************/
+static size_t tree_to_array(node *root, int *out, size_t n, size_t pos)
+{
+	if(NULL != root)
+	{
+		pos = tree_to_array(root->link[LEFT], out, n, pos);
+		if(pos < n)
+			out[pos] = root->data;
+		pos++;
+		pos = tree_to_array(root->link[RIGHT], out, n, pos);
+	}
+	return (pos);
+}
+
+/*!*******************************************************
+*	\fn eyt_freeze_tree(eyt_index *idx, node *root)
+*	\brief - freeze a binary search tree (add_node() without HEAPSORT).
+*		 The tree is left as it is.
+*	\param idx - index to fill
+*	\param root - tree root
+*	\return bool - FALSE if out of memory, or if the tree holds a
+*		 different number of nodes than its root's size says
+*********************************************************/
+bool eyt_freeze_tree(eyt_index *idx, node *root)
+{
+	size_t n = NODE_SIZE(root);
+	int *sorted = (int*) malloc((n ? n : 1) * sizeof(*sorted));
+	bool ok = FALSE;
+
+	if(NULL == sorted)
+		return (FALSE);
+	if(tree_to_array(root, sorted, n, 0) == n)
+		ok = eyt_build(idx, sorted, n);
+	free(sorted);
+	return (ok);
+}
+
+/**
+	\brief struct collect_ctx: output array of collect()
+*/
+typedef struct collect_ctx
+{
+	int *cur;
+	int *end;
+}collect_ctx;
+
+/*!*******************************************************
+*	\fn collect(int data, void *ctx)
+*	\brief - emit_fn storing the extracted values in an array. Values
+*		 past the end are dropped, so a heap whose sizes are off
+*		 can't write past the array.
+*	\param data - extracted value
+*	\param ctx - collect_ctx
+*	\return void
+*********************************************************/
+static void collect(int data, void *ctx)
+{
+	collect_ctx *c = (collect_ctx*) ctx;
+	if(c->cur < c->end)
+		*c->cur++ = data;
+}
+
+/*!*******************************************************
+*	\fn eyt_freeze_heap(eyt_index *idx, node **root)
+*	\brief - freeze the output of sort_emit(). The heap is consumed.
+*		 Everything is allocated before the heap is drained.
+*	\param idx - index to fill
+*	\param root - heap root, NULL on return
+*	\return bool - FALSE if out of memory (the heap is then untouched)
+*********************************************************/
+bool eyt_freeze_heap(eyt_index *idx, node **root)
+{
+	size_t n = NODE_SIZE(*root);
+	int *sorted = (int*) malloc((n ? n : 1) * sizeof(*sorted));
+	collect_ctx c;
+	size_t pos = 0;
+	bool ok = TRUE;
+
+	if(NULL == sorted)
+		return (FALSE);
+	if(FALSE == eyt_alloc(idx, n))
+	{
+		free(sorted);
+		return (FALSE);
+	}
+	c.cur = sorted;
+	c.end = sorted + n;
+	sort_emit(root, collect, &c);
+
+	/* Fewer values than the root's size claimed: the layout depends on
+	   the count, so lay it out again for the real one */
+	if((size_t)(c.cur - sorted) != n)
+	{
+		eyt_free(idx);
+		ok = eyt_build(idx, sorted, (size_t)(c.cur - sorted));
+	}
+	else
+		eyt_fill(idx, sorted, &pos, 1);
+	free(sorted);
+	return (ok);
+}
+
+/*!*******************************************************
+*	\fn eyt_find_batch(const eyt_index *idx, const int *keys, size_t n, bool *found)
+*	\brief - eyt_find() for a whole array of keys. Groups of
+*		 FIND_BATCH_GROUP searches descend level by level in
+*		 lockstep, so their cache misses overlap.
+*	\param idx - frozen index
+*	\param keys - keys to look for
+*	\param n - number of keys
+*	\param found - out: found[i] is TRUE if keys[i] is present
+*	\return size_t - number of keys found
+*********************************************************/
+size_t eyt_find_batch(const eyt_index *idx, const int *keys, size_t n, bool *found)
+{
+	size_t k[FIND_BATCH_GROUP];
+	size_t hits = 0;
+	size_t base = 0;
+	size_t g = 0;
+	size_t j = 0;
+	bool more = FALSE;
+
+	for(base = 0; base < n; base += g)
+	{
+		g = ((n - base) < FIND_BATCH_GROUP) ? (n - base) : FIND_BATCH_GROUP;
+		for(j = 0; j < g; j++)
+			k[j] = 1;
+
+		/* One level of every search per round; the leaves are at most one
+		   level apart, so lanes that are done simply sit out the last round */
+		do
+		{
+			more = FALSE;
+			for(j = 0; j < g; j++)
+			{
+				if(k[j] <= idx->n)
+				{
+					k[j] = (2 * k[j]) + (idx->keys[k[j]] < keys[base + j]);
+					__builtin_prefetch(idx->keys + k[j]);
+					more = TRUE;
+				}
+			}
+		}while(TRUE == more);
+
+		for(j = 0; j < g; j++)
+		{
+			k[j] >>= __builtin_ffsl(~k[j]);
+			found[base + j] = ((0 != k[j]) && (idx->keys[k[j]] == keys[base + j])) ? TRUE : FALSE;
+			hits += found[base + j];
+		}
+	}
+	return (hits);
+}
+
+/*!*******************************************************
+*	\fn eyt_free(eyt_index *idx)
+*	\brief - release the index
+*	\param idx - index
+*	\return void
+*********************************************************/
+void eyt_free(eyt_index *idx)
+{
+	huge_free(idx->keys, (idx->n + 1) * sizeof(int));
+	idx->keys = NULL;
+	idx->n = 0;
+}
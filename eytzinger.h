@@ -0,0 +1,119 @@
+/**
+* @file eytzinger.h
+* @brief Static, read-only search layout. A tree or sorted array is frozen
+*        into one array in Eytzinger (BFS) order: the children of slot k are
+*        2k and 2k+1, so the top levels of every search share the same few
+*        cache lines and the descendants 4 levels down sit in one 64 byte
+*        line that can be prefetched while the current level is compared.
+*        The search loop has no data dependent branch.
+*/
+
+#ifndef _EYTZINGER_H_
+#define _EYTZINGER_H_
+
+#include "heapsort.h"
+
+/** Keys per 64 byte cache line, also how far ahead the lookup prefetches */
+#define EYT_LINE_KEYS	(64 / sizeof(int))
+
+/**
+	\brief struct eyt_index: frozen key set
+*/
+typedef struct eyt_index
+{
+	/** keys[1..n] in BFS order, keys[0] is unused */
+	int *keys;
+	/** Number of keys */
+	size_t n;
+}eyt_index;
+
+/*!*******************************************************
+*	\fn eyt_build(eyt_index *idx, const int *sorted, size_t n)
+*	\brief - lay out an ascending array in Eytzinger order
+*	\param idx - index to fill
+*	\param sorted - n keys, ascending
+*	\param n - number of keys
+*	\return bool - FALSE if out of memory
+*********************************************************/
+bool eyt_build(eyt_index *idx, const int *sorted, size_t n);
+
+/*!*******************************************************
+*	\fn eyt_freeze_tree(eyt_index *idx, node *root)
+*	\brief - freeze a binary search tree (add_node() without HEAPSORT).
+*		 The tree is left as it is.
+*	\param idx - index to fill
+*	\param root - tree root
+*	\return bool - FALSE if out of memory, or if the tree holds a
+*		 different number of nodes than its root's size says
+*********************************************************/
+bool eyt_freeze_tree(eyt_index *idx, node *root);
+
+/*!*******************************************************
+*	\fn eyt_freeze_heap(eyt_index *idx, node **root)
+*	\brief - freeze the output of sort_emit(). The heap is consumed.
+*		 Everything is allocated before the heap is drained.
+*	\param idx - index to fill
+*	\param root - heap root, NULL on return
+*	\return bool - FALSE if out of memory (the heap is then untouched)
+*********************************************************/
+bool eyt_freeze_heap(eyt_index *idx, node **root);
+
+/*!*******************************************************
+*	\fn eyt_lower_bound(const eyt_index *idx, int key)
+*	\brief - slot of the smallest key >= key
+*	\param idx - frozen index
+*	\param key - key to look for
+*	\return size_t - slot in idx->keys, 0 if every key is smaller
+*********************************************************/
+static inline size_t eyt_lower_bound(const eyt_index *idx, int key)
+{
+	const int *keys = idx->keys;
+	size_t n = idx->n;
+	size_t k = 1;
+
+	while(k <= n)
+	{
+		/* Slot 16k is 4 levels down; prefetch never faults, even past the end */
+		__builtin_prefetch(keys + (k * EYT_LINE_KEYS));
+		k = (2 * k) + (keys[k] < key);
+	}
+	/* Undo the trailing right turns plus the last left turn */
+	k >>= __builtin_ffsl(~k);
+	return (k);
+}
+
+/*!*******************************************************
+*	\fn eyt_find(const eyt_index *idx, int key)
+*	\brief - find_node() on the frozen index
+*	\param idx - frozen index
+*	\param key - key to look for
+*	\return bool - TRUE if key is present
+*********************************************************/
+static inline bool eyt_find(const eyt_index *idx, int key)
+{
+	size_t k = eyt_lower_bound(idx, key);
+	return (((0 != k) && (idx->keys[k] == key)) ? TRUE : FALSE);
+}
+
+/*!*******************************************************
+*	\fn eyt_find_batch(const eyt_index *idx, const int *keys, size_t n, bool *found)
+*	\brief - eyt_find() for a whole array of keys. Groups of
+*		 FIND_BATCH_GROUP searches descend level by level in
+*		 lockstep, so their cache misses overlap.
+*	\param idx - frozen index
+*	\param keys - keys to look for
+*	\param n - number of keys
+*	\param found - out: found[i] is TRUE if keys[i] is present
+*	\return size_t - number of keys found
+*********************************************************/
+size_t eyt_find_batch(const eyt_index *idx, const int *keys, size_t n, bool *found);
+
+/*!*******************************************************
+*	\fn eyt_free(eyt_index *idx)
+*	\brief - release the index
+*	\param idx - index
+*	\return void
+*********************************************************/
+void eyt_free(eyt_index *idx);
+
+#endif // _EYTZINGER_H_
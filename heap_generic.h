@@ -0,0 +1,424 @@
+/**
+* @file heap_generic.h
+* @brief Type generic versions of the heap, binary tree and sorted list.
+*
+*        The int only code in heap_util.c/heapsort.c/llist.c is hard-wired to
+*        int data and the < and > operators. The macros below stamp out the
+*        same structures for any key type, with the comparison passed in as a
+*        macro so it is expanded in place; there is no function pointer in any
+*        of the generated loops. Example:
+*
+*            GEN_HEAP(ts, int64_t, KEY_LT)
+*            GEN_TREE(ts, int64_t, KEY_LT)
+*            GEN_LIST(ts, int64_t, KEY_LT)
+*
+*        gives ts_heap_push()/ts_heap_pop(), ts_add_node()/ts_find_node() and
+*        ts_insert_node() etc. operating on int64_t. Records sort on a field
+*        with KEY_LT_MEMBER, floats and doubles with KEY_LT_FLOAT/KEY_LT_DOUBLE.
+*/
+
+#ifndef _HEAP_GENERIC_H_
+#define _HEAP_GENERIC_H_
+
+#include <stdint.h>
+#include "heapsort.h"
+
+/** Plain < for integer keys (int64_t, uint32_t, ...) */
+#define KEY_LT(a, b)		((a) < (b))
+
+/** Compare records on their key member, e.g. struct { uint64_t key; ... } */
+#define KEY_LT_MEMBER(a, b)	((a).key < (b).key)
+
+/** Total order for floats: -NaN < -inf < ... < -0 < +0 < ... < +inf < +NaN */
+#define KEY_LT_FLOAT(a, b)	(key_float_bits(a) < key_float_bits(b))
+
+/** Total order for doubles, same ordering as KEY_LT_FLOAT */
+#define KEY_LT_DOUBLE(a, b)	(key_double_bits(a) < key_double_bits(b))
+
+/** Keys are equal when neither is smaller than the other */
+#define KEY_EQ(lt, a, b)	(!lt(a, b) && !lt(b, a))
+
+/*!*******************************************************
+*	\fn key_float_bits(float f)
+*	\brief - map a float to an unsigned int with the same order.
+*		 Negative numbers get all bits flipped, positive numbers
+*		 only the sign bit.
+*	\param f - value to map
+*	\return uint32_t - order preserving key
+*********************************************************/
+static inline uint32_t key_float_bits(float f)
+{
+	uint32_t u;
+	memcpy(&u, &f, sizeof(u));
+	return (u ^ ((uint32_t)(-(int32_t)(u >> 31)) | 0x80000000u));
+}
+
+/*!*******************************************************
+*	\fn key_double_bits(double d)
+*	\brief - map a double to an unsigned 64 bit int with the same order
+*	\param d - value to map
+*	\return uint64_t - order preserving key
+*********************************************************/
+static inline uint64_t key_double_bits(double d)
+{
+	uint64_t u;
+	memcpy(&u, &d, sizeof(u));
+	return (u ^ ((uint64_t)(-(int64_t)(u >> 63)) | 0x8000000000000000ull));
+}
+
+/*!****************************************************************************
+	\def GEN_HEAP(prefix, T, LT)
+	\brief - Array backed min-heap of T. Children of slot x are [2x+1] and
+	         [2x+2], parent is [(x-1)/2], same numbering as struct node.
+	         Generates:
+	         prefix_heap                  - heap handle (zero it to init)
+	         prefix_heap_reserve(h, cap)  - room for cap values, FALSE if out of memory
+	         prefix_heap_push(h, v)       - add v, returns FALSE if out of memory
+	         prefix_heap_pop(h, &v)       - remove smallest into v, FALSE if empty
+	         prefix_heap_peek(h)          - pointer to smallest, NULL if empty
+	         prefix_heap_free(h)          - release storage
+	         prefix_sift_up(a, i)         - normalize_tree() for slot i
+	         prefix_sift_down(a, n, i)    - normalize_tree_root() for slot i
+	         prefix_heapify(a, n)         - build a min-heap in place in O(n)
+	         prefix_heapsort(a, n)        - sort a[] ascending in place
+*****************************************************************************/
+#define GEN_HEAP(prefix, T, LT)							\
+	GEN_HEAP_ALLOC(prefix, T, LT, heap_std_realloc, heap_std_free)
+
+/*!*******************************************************
+*	\fn heap_std_realloc(void *p, size_t old_len, size_t len)
+*	\brief - realloc() with the allocator signature GEN_HEAP_ALLOC expects
+*	\param p - block
+*	\param old_len - current size, unused
+*	\param len - new size
+*	\return void * - block, NULL if out of memory
+*********************************************************/
+static inline void* heap_std_realloc(void *p, size_t old_len, size_t len)
+{
+	(void) old_len;
+	return (realloc(p, len));
+}
+
+/*!*******************************************************
+*	\fn heap_std_free(void *p, size_t len)
+*	\brief - free() with the allocator signature GEN_HEAP_ALLOC expects
+*	\param p - block
+*	\param len - size, unused
+*	\return void
+*********************************************************/
+static inline void heap_std_free(void *p, size_t len)
+{
+	(void) len;
+	free(p);
+}
+
+/*!****************************************************************************
+	\def GEN_HEAP_ALLOC(prefix, T, LT, REALLOC, FREE)
+	\brief - GEN_HEAP with the storage coming from another allocator, e.g.
+	         huge_realloc()/huge_free() for heaps of hundreds of millions of
+	         keys. REALLOC(p, old_bytes, new_bytes) and FREE(p, bytes) are
+	         told the size of the block, so the allocator doesn't have to
+	         keep it.
+*****************************************************************************/
+#define GEN_HEAP_ALLOC(prefix, T, LT, REALLOC, FREE)				\
+typedef struct prefix##_heap							\
+{										\
+	T *v;									\
+	size_t n;								\
+	size_t cap;								\
+}prefix##_heap;									\
+										\
+static inline void prefix##_sift_up(T *a, size_t i)				\
+{										\
+	T v = a[i];								\
+	while(0 != i)								\
+	{									\
+		size_t p = (i - 1) / 2;						\
+		if(!(LT(v, a[p])))						\
+			break;							\
+		a[i] = a[p];							\
+		i = p;								\
+	}									\
+	a[i] = v;								\
+}										\
+										\
+static inline void prefix##_sift_down(T *a, size_t n, size_t i)		\
+{										\
+	T v = a[i];								\
+	size_t c;								\
+	while((c = (2 * i) + 1) < n)						\
+	{									\
+		if(((c + 1) < n) && LT(a[c + 1], a[c]))				\
+			c++;							\
+		if(!(LT(a[c], v)))						\
+			break;							\
+		a[i] = a[c];							\
+		i = c;								\
+	}									\
+	a[i] = v;								\
+}										\
+										\
+static inline void prefix##_heapify(T *a, size_t n)				\
+{										\
+	size_t i = n / 2;							\
+	while(0 != i--)								\
+		prefix##_sift_down(a, n, i);					\
+}										\
+										\
+/* Max-heap sift used by the in place sort, largest goes to the back */	\
+static inline void prefix##_sift_down_max(T *a, size_t n, size_t i)		\
+{										\
+	T v = a[i];								\
+	size_t c;								\
+	while((c = (2 * i) + 1) < n)						\
+	{									\
+		if(((c + 1) < n) && LT(a[c], a[c + 1]))				\
+			c++;							\
+		if(!(LT(v, a[c])))						\
+			break;							\
+		a[i] = a[c];							\
+		i = c;								\
+	}									\
+	a[i] = v;								\
+}										\
+										\
+static inline void prefix##_heapsort(T *a, size_t n)				\
+{										\
+	size_t i = n / 2;							\
+	T t;									\
+	while(0 != i--)								\
+		prefix##_sift_down_max(a, n, i);				\
+	while(n > 1)								\
+	{									\
+		n--;								\
+		t = a[0]; a[0] = a[n]; a[n] = t;				\
+		prefix##_sift_down_max(a, n, 0);				\
+	}									\
+}										\
+										\
+static inline bool prefix##_heap_reserve(prefix##_heap *h, size_t cap)	\
+{										\
+	T *nv = NULL;								\
+	if(cap <= h->cap)							\
+		return (TRUE);							\
+	nv = (T*) REALLOC(h->v, h->cap * sizeof(T), cap * sizeof(T));		\
+	if(NULL == nv)								\
+		return (FALSE);							\
+	h->v = nv;								\
+	h->cap = cap;								\
+	return (TRUE);								\
+}										\
+										\
+static inline bool prefix##_heap_push(prefix##_heap *h, T v)			\
+{										\
+	if((h->n == h->cap) &&							\
+	   (FALSE == prefix##_heap_reserve(h, (0 == h->cap) ? 16 : (2 * h->cap))))	\
+		return (FALSE);							\
+	h->v[h->n] = v;								\
+	prefix##_sift_up(h->v, h->n++);						\
+	return (TRUE);								\
+}										\
+										\
+static inline bool prefix##_heap_pop(prefix##_heap *h, T *out)		\
+{										\
+	if(0 == h->n)								\
+		return (FALSE);							\
+	*out = h->v[0];								\
+	h->v[0] = h->v[--h->n];							\
+	if(0 != h->n)								\
+		prefix##_sift_down(h->v, h->n, 0);				\
+	return (TRUE);								\
+}										\
+										\
+static inline T* prefix##_heap_peek(prefix##_heap *h)				\
+{										\
+	return ((0 == h->n) ? NULL : &h->v[0]);					\
+}										\
+										\
+static inline void prefix##_heap_free(prefix##_heap *h)			\
+{										\
+	FREE(h->v, h->cap * sizeof(T));						\
+	h->v = NULL;								\
+	h->n = h->cap = 0;							\
+}
+
+/*!****************************************************************************
+	\def GEN_TREE(prefix, T, LT)
+	\brief - Pointer tree of T with the same layout and rules as struct node:
+	         keys that are not larger go LEFT, larger go RIGHT. Generates:
+	         prefix_node                       - tree node
+	         prefix_add_node(&root, v, heap)   - add_node(); with heap == TRUE
+	                                              the new key is normalized
+	                                              upwards like HEAPSORT builds
+	         prefix_find_node(root, v)         - find_node(), iterative
+	         prefix_sort_into(&root, out)      - sort_emit() into out[], frees
+	                                              the tree, returns the count
+	         prefix_free_tree(root)            - free_tree()
+*****************************************************************************/
+#define GEN_TREE(prefix, T, LT)							\
+typedef struct prefix##_node							\
+{										\
+	struct prefix##_node *link[NUM_LINKS];					\
+	struct prefix##_node *parent;						\
+	T data;									\
+}prefix##_node;									\
+										\
+static inline bool prefix##_add_node(prefix##_node **root, T v, bool heap)	\
+{										\
+	prefix##_node *parent = NULL;						\
+	prefix##_node *n;							\
+	T t;									\
+	while(NULL != *root)							\
+	{									\
+		parent = *root;							\
+		root = &parent->link[LT(parent->data, v) ? RIGHT : LEFT];	\
+	}									\
+	n = (prefix##_node*) malloc(sizeof(*n));				\
+	if(NULL == n)								\
+		return (FALSE);							\
+	n->link[LEFT] = n->link[RIGHT] = NULL;					\
+	n->parent = parent;							\
+	n->data = v;								\
+	*root = n;								\
+	/* normalize_tree(): bubble the key up while it beats its parent */	\
+	while((TRUE == heap) && (NULL != n->parent) && LT(n->data, n->parent->data)) \
+	{									\
+		t = n->data; n->data = n->parent->data; n->parent->data = t;	\
+		n = n->parent;							\
+	}									\
+	return (TRUE);								\
+}										\
+										\
+static inline prefix##_node* prefix##_find_node(prefix##_node *root, T v)	\
+{										\
+	while(NULL != root)							\
+	{									\
+		if(LT(root->data, v))						\
+			root = root->link[RIGHT];				\
+		else if(LT(v, root->data))					\
+			root = root->link[LEFT];				\
+		else								\
+			break;							\
+	}									\
+	return (root);								\
+}										\
+										\
+static inline size_t prefix##_sort_into(prefix##_node **root, T *out)	\
+{										\
+	size_t cnt = 0;								\
+	prefix##_node *lc;							\
+	prefix##_node *n;							\
+	prefix##_node *sc;							\
+	T t;									\
+	while(NULL != *root)							\
+	{									\
+		out[cnt++] = (*root)->data;					\
+		/* get_last_child(): right-most path down to a leaf */		\
+		lc = *root;							\
+		while((NULL != lc->link[LEFT]) || (NULL != lc->link[RIGHT]))	\
+			lc = (NULL != lc->link[RIGHT]) ? lc->link[RIGHT] : lc->link[LEFT]; \
+		if(lc == *root)							\
+		{								\
+			free(lc);						\
+			*root = NULL;						\
+			break;							\
+		}								\
+		(*root)->data = lc->data;					\
+		/* Unlink by pointer so duplicate keys can't confuse it */	\
+		lc->parent->link[(lc->parent->link[LEFT] == lc) ? LEFT : RIGHT] = NULL; \
+		free(lc);							\
+		/* normalize_tree_root() */					\
+		n = *root;							\
+		while(NULL != n)						\
+		{								\
+			sc = n->link[LEFT];					\
+			if((NULL == sc) || ((NULL != n->link[RIGHT]) && LT(n->link[RIGHT]->data, sc->data))) \
+				sc = n->link[RIGHT];				\
+			if((NULL == sc) || !(LT(sc->data, n->data)))		\
+				break;						\
+			t = sc->data; sc->data = n->data; n->data = t;		\
+			n = sc;							\
+		}								\
+	}									\
+	return (cnt);								\
+}										\
+										\
+static inline void prefix##_free_tree(prefix##_node *root)			\
+{										\
+	if(NULL != root)							\
+	{									\
+		prefix##_free_tree(root->link[LEFT]);				\
+		prefix##_free_tree(root->link[RIGHT]);				\
+		free(root);							\
+	}									\
+}
+
+/*!****************************************************************************
+	\def GEN_LIST(prefix, T, LT)
+	\brief - Doubly linked list of T kept in the same (descending) order as
+	         insert_node() in llist.c. Generates:
+	         prefix_lnode                       - list node
+	         prefix_insert_node(&head, v)       - insert_node()
+	         prefix_delete_node(&head, v)       - delete_node(), FALSE if absent
+	         prefix_free_link_nodes(&head)      - free_link_nodes()
+*****************************************************************************/
+#define GEN_LIST(prefix, T, LT)							\
+typedef struct prefix##_lnode							\
+{										\
+	struct prefix##_lnode *link[NUM_LINKS];					\
+	T data;									\
+}prefix##_lnode;								\
+										\
+static inline bool prefix##_insert_node(prefix##_lnode **head, T v)		\
+{										\
+	prefix##_lnode *prev = NULL;						\
+	prefix##_lnode *iter = *head;						\
+	prefix##_lnode *n = (prefix##_lnode*) malloc(sizeof(*n));		\
+	if(NULL == n)								\
+		return (FALSE);							\
+	while((NULL != iter) && LT(v, iter->data))				\
+	{									\
+		prev = iter;							\
+		iter = iter->link[NEXT];					\
+	}									\
+	n->data = v;								\
+	n->link[PREV] = prev;							\
+	n->link[NEXT] = iter;							\
+	if(NULL != iter)							\
+		iter->link[PREV] = n;						\
+	if(NULL != prev)							\
+		prev->link[NEXT] = n;						\
+	else									\
+		*head = n;							\
+	return (TRUE);								\
+}										\
+										\
+static inline bool prefix##_delete_node(prefix##_lnode **head, T v)		\
+{										\
+	prefix##_lnode *iter = *head;						\
+	while((NULL != iter) && !KEY_EQ(LT, iter->data, v))			\
+		iter = iter->link[NEXT];					\
+	if(NULL == iter)							\
+		return (FALSE);							\
+	if(NULL != iter->link[PREV])						\
+		iter->link[PREV]->link[NEXT] = iter->link[NEXT];		\
+	else									\
+		*head = iter->link[NEXT];					\
+	if(NULL != iter->link[NEXT])						\
+		iter->link[NEXT]->link[PREV] = iter->link[PREV];		\
+	free(iter);								\
+	return (TRUE);								\
+}										\
+										\
+static inline void prefix##_free_link_nodes(prefix##_lnode **head)		\
+{										\
+	prefix##_lnode *mem;							\
+	while(NULL != *head)							\
+	{									\
+		mem = (*head)->link[NEXT];					\
+		free(*head);							\
+		*head = mem;							\
+	}									\
+}
+
+#endif // _HEAP_GENERIC_H_
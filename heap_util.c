@@ -20,6 +20,7 @@ node *new()
 	{
 		new_node->link[0] = new_node->link[1] = NULL;
 		new_node->data = 0;
+		new_node->size = 1;
 	}
 	return (new_node);
 }
@@ -191,6 +192,7 @@ node *create_node(int data, node *parent)
 	{
 		ndata->link[LEFT] = ndata->link[RIGHT] = NULL;
 		ndata->data = data;
+		ndata->size = 1;
 		ndata->parent = parent;
 		if(NULL != parent)
 			PRINT("%d's parent is %d\n", data, parent->data);
@@ -220,6 +222,70 @@ node *find_node(node *root, int data)
 	return (found);
 }
 
+/*!****************************************************************************
+*	\fn find_nodes_batch(node *root, const int *keys, size_t n, node **out)
+*	\brief -  find_node() for a whole array of keys. Up to FIND_BATCH_GROUP
+*		   searches advance in turn, one level each, and every step
+*		   prefetches the child it is going to visit next, so the cache
+*		   misses of different searches overlap instead of queueing.
+*	\param root - tree root
+*	\param keys - keys to look for
+*	\param n - number of keys
+*	\param out - out: out[i] is the node matching keys[i], NULL if not found
+*	\return size_t - number of keys found
+******************************************************************************/
+size_t find_nodes_batch(node *root, const int *keys, size_t n, node **out)
+{
+	node *cur[FIND_BATCH_GROUP];
+	size_t slot[FIND_BATCH_GROUP];
+	size_t next = 0;
+	size_t live = 0;
+	size_t found = 0;
+	size_t j = 0;
+	node *c = NULL;
+
+	/* Start the first group of searches at the root */
+	for(live = 0; (live < FIND_BATCH_GROUP) && (next < n); live++)
+	{
+		cur[live] = root;
+		slot[live] = next++;
+	}
+
+	while(0 != live)
+	{
+		for(j = 0; j < live; )
+		{
+			c = cur[j];
+			if((NULL != c) && (keys[slot[j]] != c->data))
+			{
+				/* Not there yet: step down, and have the line in
+				   flight by the time this lane comes round again */
+				c = c->link[DIR(keys[slot[j]], c->data)];
+				__builtin_prefetch(c);
+				cur[j++] = c;
+				continue;
+			}
+
+			/* Lane finished, hit or miss: record it and refill the lane
+			   with the next key, or retire it if there is none */
+			out[slot[j]] = c;
+			found += (NULL != c);
+			if(next < n)
+			{
+				cur[j] = root;
+				slot[j] = next++;
+			}
+			else
+			{
+				live--;
+				cur[j] = cur[live];
+				slot[j] = slot[live];
+			}
+		}
+	}
+	return (found);
+}
+
 
 /*!****************************************************************************
 *	\fn get_last_child(node *root)
@@ -313,6 +379,9 @@ void rotate_tree_left(node **root)
    /* Update parents */
    old_root->parent = *root;
    (*root)->parent = NULL;
+   /* Old root lost a subtree, new root now holds everything */
+   old_root->size = 1 + NODE_SIZE(old_root->link[LEFT]) + NODE_SIZE(old_root->link[RIGHT]);
+   (*root)->size = 1 + NODE_SIZE((*root)->link[LEFT]) + NODE_SIZE((*root)->link[RIGHT]);
 }
 
 /*!****************************************************************************
@@ -341,4 +410,7 @@ void rotate_tree_right(node **root)
    /* Update parents */
    old_root->parent = *root;
    (*root)->parent = NULL;
+   /* Old root lost a subtree, new root now holds everything */
+   old_root->size = 1 + NODE_SIZE(old_root->link[LEFT]) + NODE_SIZE(old_root->link[RIGHT]);
+   (*root)->size = 1 + NODE_SIZE((*root)->link[LEFT]) + NODE_SIZE((*root)->link[RIGHT]);
 }
@@ -6,6 +6,22 @@
 
 
 #include "heapsort.h"
+#ifdef PIPELINE
+ #include "pipeline.h"
+#endif /* PIPELINE */
+#ifdef TRACE
+ #include "trace.h"
+ /* main() records into the file named by $TRACE_FILE. add_node() is a
+    push into the heap or an insert into the search tree. */
+ #ifdef HEAPSORT
+  #define TRACE_ADD	TRACE_PUSH
+ #else
+  #define TRACE_ADD	TRACE_INSERT
+ #endif /* HEAPSORT */
+ #define TRACE_REC(tw, op, arg)	trace_record(tw, op, arg)
+#else
+ #define TRACE_REC(tw, op, arg)
+#endif /* TRACE */
 
 //#define HEAPSORT
 
@@ -33,6 +49,12 @@ void add_node(node **root, int data, node *parent)
 	else
 	{
 		*root = create_node(data, parent);
+		if(NULL == *root)
+			return;
+		/* Only count the node on its ancestors once it exists, so sizes
+		   stay right if the allocation fails */
+		for(; NULL != parent; parent = parent->parent)
+			parent->size++;
      #ifdef HEAPSORT
       /* Created node, re-arrange it in the tree such that it is
 		   smaller than its parent. If normalizing, then tree is used
@@ -122,6 +144,19 @@ void normalize_tree_root(node *root)
 }
 
 
+/*!***************************************************************************
+	\fn print_extracted(int data, void *ctx)
+	\brief - emit_fn used by sort() to print each extracted value
+	\param data - extracted value
+	\param ctx - unused
+	\return - void
+*****************************************************************************/
+static void print_extracted(int data, void *ctx)
+{
+	(void) ctx;
+	printf("Extracting %d\n", data);
+}
+
 /*!***************************************************************************
 	\fn sort(node **root)
 	\brief - The sorting function
@@ -130,56 +165,104 @@ void normalize_tree_root(node *root)
 *****************************************************************************/
 void sort(node **root)
 {
-	int i = 10;
+	sort_emit(root, print_extracted, NULL);
+	printf(" Done sorting!!\n");
+}
+
+/*!***************************************************************************
+	\fn sort_emit(node **root, emit_fn emit, void *ctx)
+	\brief - Drain the heap smallest first, handing every value to emit()
+	\param **root - tree root
+	\param emit - called with every extracted value
+	\param ctx - passed through to emit
+	\return - void
+*****************************************************************************/
+void sort_emit(node **root, emit_fn emit, void *ctx)
+{
+	int data = 0;
+	while(TRUE == extract_min(root, &data))
+		emit(data, ctx);
+}
+
+/*!***************************************************************************
+	\fn extract_min(node **root, int *data)
+	\brief - Remove the smallest value from the heap
+	\param **root - tree root, NULL once the last node is gone
+	\param data - out: the smallest value
+	\return - bool - FALSE if the heap was empty
+*****************************************************************************/
+bool extract_min(node **root, int *data)
+{
 	node *lc = NULL;
-	while(NULL != *root)
-	{
-		/* Get last node which is one of the largest nodes (definitely larger than our current root)
-		   and make it the root of the tree. Then normalize tree so the next smallest number can 
-		   float to the top */
-		lc = get_last_child(*root);
+	node *iter = NULL;
 
-		/* Reached the root, last element */
-		if(lc == *root)
-		{
-			printf("Extracting %d\n Done sorting!!\n", lc->data);
-			free(*root);
-			lc = *root = NULL;
-		}
+	if(NULL == *root)
+		return (FALSE);
 
-		if(lc)
-		{
-			int data = lc->data;
-			/* Extract the current root which is the smallest number currently */
-			printf("Extracting %d\n", (*root)->data);
-
-			/* Set root to the larger child, which is brought up from below */
-			(*root)->data = data;
-		
-			/* Free the child's old node as it is now at the root position. Make sure we 
-			   set it's parent's link to it to NULL. 
-			   Don't really need to check if its parent is NULL or not (its not as its not 
-			   the tree root), but we do it for sanity check. */
-			if(NULL != lc->parent)
-			{
-				if(NULL != lc->parent->link[LEFT])
-					if(lc->parent->link[LEFT]->data == lc->data)
-						lc->parent->link[LEFT] = NULL;
-				if(NULL != lc->parent->link[RIGHT])
-					if(lc->parent->link[RIGHT]->data == lc->data)
-						lc->parent->link[RIGHT] = NULL;
-			}
+	/* Get last node which is one of the largest nodes (definitely larger than our current root)
+	   and make it the root of the tree. Then normalize tree so the next smallest number can 
+	   float to the top */
+	lc = get_last_child(*root);
 
-			/* Parent link to this is now NULL, free it */
-			free(lc);
-			lc = NULL;
+	/* Extract the current root which is the smallest number currently */
+	*data = (*root)->data;
 
-			/* The child which is one of the largest nodes in this tree is sitting at the 
-			   root, normalize tree so that it sinks to the bottom and next smallest node
-			   floats to the top */
-			normalize_tree_root(*root);
-		}
+	/* Reached the root, last element */
+	if(lc == *root)
+	{
+		free(*root);
+		*root = NULL;
+		return (TRUE);
+	}
+
+	/* Set root to the larger child, which is brought up from below */
+	(*root)->data = lc->data;
+
+	/* Free the child's old node as it is now at the root position. Make sure we 
+	   set it's parent's link to it to NULL. 
+	   Don't really need to check if its parent is NULL or not (its not as its not 
+	   the tree root), but we do it for sanity check.
+	   Match on the node itself, not its data: a sibling holding the same value
+	   would otherwise be cut off as well. */
+	if(NULL != lc->parent)
+	{
+		if(lc->parent->link[LEFT] == lc)
+			lc->parent->link[LEFT] = NULL;
+		else if(lc->parent->link[RIGHT] == lc)
+			lc->parent->link[RIGHT] = NULL;
 	}
+
+	/* Every subtree that held the freed node is one smaller now, so pushes
+	   and pops can be mixed without the sizes drifting */
+	for(iter = lc->parent; NULL != iter; iter = iter->parent)
+		iter->size--;
+
+	/* Parent link to this is now NULL, free it */
+	free(lc);
+
+	/* The child which is one of the largest nodes in this tree is sitting at the 
+	   root, normalize tree so that it sinks to the bottom and next smallest node
+	   floats to the top */
+	normalize_tree_root(*root);
+	return (TRUE);
+}
+
+/*!***************************************************************************
+	\fn extract_until(node **root, int limit, int *out, size_t max)
+	\brief - Pop every value <= limit, smallest first, into out[]
+	\param **root - tree root
+	\param limit - largest value to pop
+	\param out - out: popped values
+	\param max - room in out
+	\return - size_t - number of values written, max if more may be due
+*****************************************************************************/
+size_t extract_until(node **root, int limit, int *out, size_t max)
+{
+	size_t got = 0;
+
+	while((got < max) && (NULL != *root) && ((*root)->data <= limit))
+		extract_min(root, &out[got++]);
+	return (got);
 }
 
 /*!***************************************************************************
@@ -201,18 +284,24 @@ void balance_tree(node **root)
       height = find_tree_balance(*root);
       PRINT("Old root: %d New root: %d(%p) height is %d\n", 
             oldroot->data, (*root)->data, *root, height);
+      (void) oldroot;	/* only read by PRINT */
    }
 }
 
+#ifndef HEAPSORT_NO_MAIN
 /*!*************************************************************************
 	\fn main
-	\brief - main fn to perform heapsort
+	\brief - main fn to perform heapsort. Build with -DHEAPSORT_NO_MAIN to
+		 link the tree/heap functions into another program.
 ****************************************************************************/
 int main(void)
 {
 	node *root = NULL;
 	int      i = 0;
 	int   scan = 0;
+#ifdef TRACE
+	trace_writer *tw = trace_open_env();
+#endif /* TRACE */
 #if 0
 	int arr[] = {5,10,7,4,15,25,13};
 
@@ -224,6 +313,39 @@ int main(void)
     #endif  /* !HEAPSORT */
 	}
 	PRINT("============ BEGIN SORTING============\n");
+#elif defined(PIPELINE)
+	/* Parser thread reads ahead while we build the tree from the batches
+	   it has already handed over */
+	pipe_stage *in = pipe_start_parser(stdin);
+	pipe_batch *batch = NULL;
+	if(NULL == in)
+	{
+		/* No parser thread, read the same input here */
+		fprintf(stderr, "parser thread failed to start, reading serially\n");
+		while((1 == scanf("%d", &scan)) && (PIPE_END_MARKER != scan))
+		{
+			TRACE_REC(tw, TRACE_ADD, scan);
+			add_node(&root, scan, root);
+
+        #ifndef HEAPSORT
+         balance_tree(&root);
+        #endif  /* !HEAPSORT */
+		}
+	}
+	while((NULL != in) && (NULL != (batch = pipe_next_batch(in))))
+	{
+		for(i = 0; i < batch->count; i++)
+		{
+			TRACE_REC(tw, TRACE_ADD, batch->vals[i]);
+			add_node(&root, batch->vals[i], root);
+
+        #ifndef HEAPSORT
+         balance_tree(&root);
+        #endif  /* !HEAPSORT */
+		}
+		pipe_release_batch(in);
+	}
+	pipe_stop(in);
 #else
 	while(1)
 	{
@@ -233,6 +355,7 @@ int main(void)
 			break;
 		else
       {
+			TRACE_REC(tw, TRACE_ADD, scan);
 			add_node(&root, scan, root);
 
         #ifndef HEAPSORT
@@ -242,11 +365,38 @@ int main(void)
    }
 #endif
 
+#if defined(TRACE) && defined(HEAPSORT)
+	/* Both drain paths below pop every node */
+	for(i = 0; i < (int) NODE_SIZE(root); i++)
+		trace_record(tw, TRACE_POP, 0);
+#endif /* TRACE && HEAPSORT */
+
 	print_tree(root);
 	printf("\n");
-  #ifdef HEAPSORT
+#ifdef HEAPSORT
+  #ifdef PIPELINE
+	/* Writer thread formats and prints while sort_emit() keeps extracting */
+	pipe_stage *out = pipe_start_writer(stdout);
+	if(NULL != out)
+	{
+		sort_emit(&root, pipe_emit, out);
+		pipe_stop(out);
+		printf(" Done sorting!!\n");
+	}
+	else
+	{
+		/* No writer thread, print from here with the same output */
+		fprintf(stderr, "writer thread failed to start, printing serially\n");
+		sort(&root);
+	}
+  #else
    sort(&root);
-  #endif /* HEAPSORT */
+  #endif /* PIPELINE */
+#endif /* HEAPSORT */
 	free_tree(root);
+#ifdef TRACE
+	trace_close(tw);
+#endif /* TRACE */
 	return 0;
 }
+#endif /* !HEAPSORT_NO_MAIN */
@@ -14,12 +14,15 @@
 /** Binary tree, thus number of children is 2 */
 #define NUM_LINKS (2)
 
-/** If DEBUG is defined, printf will print, else will be commented out */
-#define DEBUG
+/** If DEBUG is defined, printf will print, else will be commented out.
+    Build with -DNO_DEBUG to silence the trace output (e.g. for streaming input) */
+#ifndef NO_DEBUG
+ #define DEBUG
+#endif
 #ifdef DEBUG
  #define PRINT printf
 #else
- #define PRINT //
+ #define PRINT(...)	do {} while(0)
 #endif
 
 /*! Macros for linked list nodes */
@@ -30,6 +33,10 @@
 #define LEFT	0
 #define RIGHT	1
 
+/** Subtree size of a possibly NULL node */
+#define NODE_SIZE(n) \
+	((NULL == (n)) ? 0 : (n)->size)
+
 /** Determine whether to go left or right while adding/looking for a child */
 #define DIR(node_data, parent_data) \
 	(node_data > parent_data)?RIGHT:LEFT
@@ -50,6 +57,10 @@ typedef struct node
 	struct node *parent;
 	/** Node data */
 	int data;
+	/** Number of nodes in the subtree rooted here, this one included. Kept up
+	    to date by add_node() and the rotations so the tree can answer rank and
+	    select queries (see bst_stats.c). Fits in the padding after data. */
+	unsigned int size;
 }node;
 
 /** enum bool: define true and false
@@ -60,6 +71,9 @@ typedef enum _bool
 	TRUE
 }bool;
 
+/** Callback used to hand each extracted value to the caller during sort_emit() */
+typedef void (*emit_fn) (int data, void *ctx);
+
 /*!*******************************************************
 *	\fn new
 *	\brief - allocate space and return a new node
@@ -149,6 +163,23 @@ node* get_last_child(node *root);
 ******************************************************************************/
 node* find_node(node *root, int data);
 
+/** Number of find_nodes_batch() searches kept in flight at once */
+#define FIND_BATCH_GROUP	(16)
+
+/*!****************************************************************************
+*	\fn find_nodes_batch(node *root, const int *keys, size_t n, node **out)
+*	\brief -  find_node() for a whole array of keys. Up to FIND_BATCH_GROUP
+*		   searches advance in turn, one level each, and every step
+*		   prefetches the child it is going to visit next, so the cache
+*		   misses of different searches overlap instead of queueing.
+*	\param root - tree root
+*	\param keys - keys to look for
+*	\param n - number of keys
+*	\param out - out: out[i] is the node matching keys[i], NULL if not found
+*	\return size_t - number of keys found
+******************************************************************************/
+size_t find_nodes_batch(node *root, const int *keys, size_t n, node **out);
+
 /*!*****************************************************************
 *	\fn create_node(int data, node *parent)
 *	\brief -  create a new node with the passed in data. 
@@ -304,4 +335,202 @@ void rotate_tree_right(node **root);
 *****************************************************************************/
 void balance_tree(node **root);
 
+/*!***************************************************************************
+	\fn sort(node **root)
+	\brief - The sorting function, prints every value as it is extracted
+	\param **root - tree root
+	\return - void
+*****************************************************************************/
+void sort(node **root);
+
+/*!***************************************************************************
+	\fn sort_emit(node **root, emit_fn emit, void *ctx)
+	\brief - Same as sort(), but each extracted value is handed to emit()
+	         instead of being printed, so the output can be consumed by a
+	         separate stage (see pipeline.h). The tree is freed as it drains.
+	\param **root - tree root
+	\param emit - called with every value, smallest first
+	\param ctx - passed through to emit
+	\return - void
+*****************************************************************************/
+void sort_emit(node **root, emit_fn emit, void *ctx);
+
+/*!***************************************************************************
+	\fn extract_min(node **root, int *data)
+	\brief - Remove the smallest value from the heap (one step of sort_emit()),
+	         so pops can be interleaved with add_node()
+	\param **root - tree root, NULL once the last node is gone
+	\param data - out: the smallest value
+	\return - bool - FALSE if the heap was empty
+*****************************************************************************/
+bool extract_min(node **root, int *data);
+
+/*!***************************************************************************
+	\fn extract_until(node **root, int limit, int *out, size_t max)
+	\brief - Pop every value <= limit, smallest first, into out[]. The
+	         smallest value is (*root)->data, no call needed to peek at it.
+	\param **root - tree root
+	\param limit - largest value to pop
+	\param out - out: popped values
+	\param max - room in out
+	\return - size_t - number of values written, max if more may be due
+*****************************************************************************/
+size_t extract_until(node **root, int limit, int *out, size_t max);
+
+/* Order statistics (bst_stats.c). O(height) is O(log n) only for trees
+   from bst_bulk_load() or the cbst; balance_tree() only rotates at the
+   root, so an add_node() tree can be as deep as it is large. */
+
+/*!****************************************************************************
+*	\fn bst_rank(node *root, int data)
+*	\brief - Number of keys in the tree smaller than data, O(height)
+*	\param root - tree root
+*	\param data - key to rank
+*	\return - size_t - count of keys < data
+******************************************************************************/
+size_t bst_rank(node *root, int data);
+
+/*!****************************************************************************
+*	\fn bst_select(node *root, size_t k)
+*	\brief - Find the k-th smallest key, O(height)
+*	\param root - tree root
+*	\param k - 0 based rank
+*	\return - node * - node holding it, NULL if k is out of range
+******************************************************************************/
+node* bst_select(node *root, size_t k);
+
+/*!****************************************************************************
+*	\fn bst_percentile(node *root, double p)
+*	\brief - Nearest rank percentile, e.g. p = 99 gives the p99 value,
+*		  O(height)
+*	\param root - tree root
+*	\param p - percentile, 0 to 100
+*	\return - node * - node holding it, NULL if the tree is empty
+******************************************************************************/
+node* bst_percentile(node *root, double p);
+
+/*!****************************************************************************
+*	\fn bst_range_count(node *root, int lo, int hi)
+*	\brief - Number of keys in [lo, hi], O(height)
+*	\param root - tree root
+*	\param lo - lower bound, inclusive
+*	\param hi - upper bound, inclusive
+*	\return - size_t - count
+******************************************************************************/
+size_t bst_range_count(node *root, int lo, int hi);
+
+/*!****************************************************************************
+*	\fn bst_range_iter(node *root, int lo, int hi, emit_fn emit, void *ctx)
+*	\brief - Hand every key in [lo, hi] to emit() in ascending order,
+*		  O(height + m) for m matching keys
+*	\param root - tree root
+*	\param lo - lower bound, inclusive
+*	\param hi - upper bound, inclusive
+*	\param emit - called for every key in range
+*	\param ctx - passed through to emit
+*	\return - size_t - number of keys emitted
+*	\note FUNCTION IS RECURSIVE
+******************************************************************************/
+size_t bst_range_iter(node *root, int lo, int hi, emit_fn emit, void *ctx);
+
+/*!****************************************************************************
+*	\fn bst_first(node *root)
+*	\brief - Smallest key of the tree, start of an in-order iteration
+*	\param root - tree root
+*	\return - node * - leftmost node, NULL if the tree is empty
+******************************************************************************/
+node* bst_first(node *root);
+
+/*!****************************************************************************
+*	\fn bst_last(node *root)
+*	\brief - Largest key of the tree, start of a reverse iteration
+*	\param root - tree root
+*	\return - node * - rightmost node, NULL if the tree is empty
+******************************************************************************/
+node* bst_last(node *root);
+
+/*!****************************************************************************
+*	\fn bst_lower_bound(node *root, int data)
+*	\brief - Seek to the first key >= data
+*	\param root - tree root
+*	\param data - key to seek to
+*	\return - node * - first node not smaller than data, NULL if none
+******************************************************************************/
+node* bst_lower_bound(node *root, int data);
+
+/*!****************************************************************************
+*	\fn bst_next(node *n)
+*	\brief - In-order successor through the parent links, no stack needed
+*	\param n - current node
+*	\return - node * - next node, NULL after the last one
+******************************************************************************/
+node* bst_next(node *n);
+
+/*!****************************************************************************
+*	\fn bst_prev(node *n)
+*	\brief - In-order predecessor through the parent links
+*	\param n - current node
+*	\return - node * - previous node, NULL before the first one
+******************************************************************************/
+node* bst_prev(node *n);
+
+/*!****************************************************************************
+*	\fn bst_range_scan(node *root, int lo, int hi, emit_fn emit, void *ctx)
+*	\brief - Stream every key in [lo, hi] to emit() in ascending order,
+*		  without recursion
+*	\param root - tree root
+*	\param lo - lower bound, inclusive
+*	\param hi - upper bound, inclusive
+*	\param emit - called for every key in range
+*	\param ctx - passed through to emit
+*	\return - size_t - number of keys emitted
+******************************************************************************/
+size_t bst_range_scan(node *root, int lo, int hi, emit_fn emit, void *ctx);
+
+/**
+	\brief struct bst_pool: a tree built by bst_bulk_load(). All nodes live
+	       in one huge_alloc() block (huge pages once it is big enough, see
+	       hugemem.h) that is freed as a whole, so the tree is read-only:
+	       no add_node(), rotations, extract_min() or free_tree() on it.
+*/
+typedef struct bst_pool
+{
+	/** Tree root, NULL for an empty tree */
+	node *root;
+	/** Node storage, pool[i] holds the i-th smallest key */
+	node *pool;
+	/** Number of nodes in pool */
+	size_t count;
+}bst_pool;
+
+/*!****************************************************************************
+*	\fn bst_bulk_load(bst_pool *bp, const int *sorted, size_t n, int threads)
+*	\brief - Build a perfectly balanced tree from ascending keys in O(n), with
+*		  parent links and subtree sizes set. Free it with bst_bulk_free().
+*	\param bp - out: the tree and its node pool
+*	\param sorted - ascending keys, e.g. the output of sort_emit()
+*	\param n - number of keys, 0 gives an empty tree
+*	\param threads - extra threads to build disjoint subtrees with, 0 for none
+*	\return - bool - FALSE if n is above UINT_MAX or out of memory
+******************************************************************************/
+bool bst_bulk_load(bst_pool *bp, const int *sorted, size_t n, int threads);
+
+/*!****************************************************************************
+*	\fn bst_bulk_load_list(bst_pool *bp, node *head, int threads)
+*	\brief - bst_bulk_load() from a sorted linked list (either direction)
+*	\param bp - out: the tree and its node pool
+*	\param head - list head, the list is left as it is
+*	\param threads - extra threads to build disjoint subtrees with, 0 for none
+*	\return - bool - FALSE if the list is unsorted or out of memory
+******************************************************************************/
+bool bst_bulk_load_list(bst_pool *bp, node *head, int threads);
+
+/*!****************************************************************************
+*	\fn bst_bulk_free(bst_pool *bp)
+*	\brief - Free a tree built by bst_bulk_load() and empty bp
+*	\param bp - tree and node pool
+*	\return - void
+******************************************************************************/
+void bst_bulk_free(bst_pool *bp);
+
 #endif // _HEAPSORT_H_
@@ -0,0 +1,197 @@
+/**
+* @file hugemem.c
+* @brief Huge page backed allocation with fallback to base pages
+*/
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include "hugemem.h"
+
+const char *huge_mode_name[HUGE_MODE_COUNT] =
+{
+	"system", "off", "thp", "hugetlb"
+};
+
+/** Current mode, -1 until $HUGEMEM has been read */
+static _Atomic int cur_mode = -1;
+
+static _Atomic size_t st_hugetlb;
+static _Atomic size_t st_thp;
+static _Atomic size_t st_base;
+static _Atomic size_t st_fallbacks;
+
+/** Bytes actually mapped for a large allocation of len bytes */
+#define HUGE_ROUND(len)		(((len) + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1))
+
+/*!*******************************************************
+*	\fn huge_set_mode(huge_mode mode)
+*	\brief - set the backing for later allocations, overriding $HUGEMEM
+*	\param mode - new mode
+*	\return void
+*********************************************************/
+void huge_set_mode(huge_mode mode)
+{
+	atomic_store(&cur_mode, (int) mode);
+}
+
+/*!*******************************************************
+*	\fn huge_get_mode(void)
+*	\brief - backing used for the next large allocation
+*	\return huge_mode - current mode
+*********************************************************/
+huge_mode huge_get_mode(void)
+{
+	int m = atomic_load(&cur_mode);
+	const char *env = NULL;
+	int i = 0;
+
+	if(m < 0)
+	{
+		/* Racing first calls all read the same variable, any store wins */
+		m = HUGE_SYSTEM;
+		env = getenv(HUGE_ENV);
+		for(i = 0; (NULL != env) && (i < HUGE_MODE_COUNT); i++)
+		{
+			if(0 == strcmp(env, huge_mode_name[i]))
+				m = i;
+		}
+		atomic_store(&cur_mode, m);
+	}
+	return ((huge_mode) m);
+}
+
+/*!*******************************************************
+*	\fn map_aligned(size_t len)
+*	\brief - anonymous mapping of len bytes (a multiple of
+*		 HUGE_PAGE_SIZE) starting on a 2 MB boundary. Over-maps by
+*		 one huge page and trims, since THP only backs aligned 2 MB
+*		 extents.
+*	\param len - bytes
+*	\return void * - mapping, NULL on failure
+*********************************************************/
+static void* map_aligned(size_t len)
+{
+	char *p = (char*) mmap(NULL, len + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+			       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	size_t head = 0;
+
+	if(MAP_FAILED == p)
+		return (NULL);
+	head = (HUGE_PAGE_SIZE - ((uintptr_t) p & (HUGE_PAGE_SIZE - 1))) & (HUGE_PAGE_SIZE - 1);
+	if(0 != head)
+		munmap(p, head);
+	munmap(p + head + len, HUGE_PAGE_SIZE - head);
+	return (p + head);
+}
+
+/*!*******************************************************
+*	\fn huge_alloc(size_t len)
+*	\brief - allocate len bytes, cache line aligned, huge page backed
+*		 if len is at least HUGE_MIN_BYTES
+*	\param len - bytes
+*	\return void * - block, NULL if out of memory
+*********************************************************/
+void* huge_alloc(size_t len)
+{
+	huge_mode mode = huge_get_mode();
+	size_t map_len = HUGE_ROUND(len);
+	void *p = NULL;
+
+	if(len < HUGE_MIN_BYTES)
+		return (aligned_alloc(64, (len + 63) & ~(size_t) 63));
+
+#ifdef MAP_HUGETLB
+	if(HUGE_HUGETLB == mode)
+	{
+		/* Fails straight away unless vm.nr_hugepages has pages free */
+		p = mmap(NULL, map_len, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if(MAP_FAILED != p)
+		{
+			atomic_fetch_add(&st_hugetlb, map_len);
+			return (p);
+		}
+		PRINT("huge_alloc: MAP_HUGETLB of %zu bytes failed, trying THP\n", map_len);
+		atomic_fetch_add(&st_fallbacks, 1);
+		mode = HUGE_THP;
+	}
+#endif /* MAP_HUGETLB */
+
+	p = map_aligned(map_len);
+	if(NULL == p)
+		return (NULL);
+#ifdef MADV_HUGEPAGE
+	if((HUGE_THP == mode) || (HUGE_HUGETLB == mode))
+	{
+		/* EINVAL when THP is compiled out or set to never: base pages */
+		if(0 == madvise(p, map_len, MADV_HUGEPAGE))
+		{
+			atomic_fetch_add(&st_thp, map_len);
+			return (p);
+		}
+	}
+	else if(HUGE_OFF == mode)
+		madvise(p, map_len, MADV_NOHUGEPAGE);
+#endif /* MADV_HUGEPAGE */
+	atomic_fetch_add(&st_base, map_len);
+	return (p);
+}
+
+/*!*******************************************************
+*	\fn huge_realloc(void *p, size_t old_len, size_t len)
+*	\brief - resize a huge_alloc() block, keeping its contents. A large
+*		 block that still fits its 2 MB pages stays where it is.
+*	\param p - block, or NULL for a new one
+*	\param old_len - size p was allocated with
+*	\param len - new size
+*	\return void * - block, NULL if out of memory (p is left as it was)
+*********************************************************/
+void* huge_realloc(void *p, size_t old_len, size_t len)
+{
+	void *np = NULL;
+
+	if(NULL == p)
+		return (huge_alloc(len));
+	if((old_len >= HUGE_MIN_BYTES) && (len >= HUGE_MIN_BYTES) &&
+	   (HUGE_ROUND(old_len) == HUGE_ROUND(len)))
+		return (p);
+
+	np = huge_alloc(len);
+	if(NULL == np)
+		return (NULL);
+	memcpy(np, p, (old_len < len) ? old_len : len);
+	huge_free(p, old_len);
+	return (np);
+}
+
+/*!*******************************************************
+*	\fn huge_free(void *p, size_t len)
+*	\brief - release a huge_alloc() block
+*	\param p - block, may be NULL
+*	\param len - size it was allocated (or last resized) with
+*	\return void
+*********************************************************/
+void huge_free(void *p, size_t len)
+{
+	if(NULL == p)
+		return;
+	if(len < HUGE_MIN_BYTES)
+		free(p);
+	else
+		munmap(p, HUGE_ROUND(len));
+}
+
+/*!*******************************************************
+*	\fn huge_get_stats(huge_stats *st)
+*	\brief - copy out the allocation counters
+*	\param st - out: counters
+*	\return void
+*********************************************************/
+void huge_get_stats(huge_stats *st)
+{
+	st->hugetlb = atomic_load(&st_hugetlb);
+	st->thp = atomic_load(&st_thp);
+	st->base = atomic_load(&st_base);
+	st->fallbacks = atomic_load(&st_fallbacks);
+}
@@ -0,0 +1,115 @@
+/**
+* @file hugemem.h
+* @brief Huge page backed storage for the big flat allocations: sort
+*        scratch arrays, array heaps, bulk-built tree pools and Eytzinger
+*        indexes. Random sift and lookup traffic over gigabytes of 4 KB
+*        pages misses the TLB on nearly every access; 2 MB pages cut the
+*        number of translations by 512.
+*
+*        Allocations of HUGE_MIN_BYTES or more are mmap()ed, 2 MB aligned
+*        and rounded up to whole 2 MB pages, then backed according to the
+*        mode (HUGE_HUGETLB falls back to HUGE_THP, which falls back to
+*        base pages if the kernel says no). Smaller ones come from the C
+*        allocator. The mode is taken from $HUGEMEM (off, thp, hugetlb)
+*        on first use and can be changed with huge_set_mode().
+*
+*        The size is passed back to huge_free() and huge_realloc(), the
+*        same as it was handed to huge_alloc(); nothing is stored in
+*        front of the block.
+*/
+
+#ifndef _HUGEMEM_H_
+#define _HUGEMEM_H_
+
+#include "heapsort.h"
+
+/** Size of a huge page on x86-64 and arm64 with 4 KB base pages */
+#define HUGE_PAGE_SIZE		((size_t) 2 << 20)
+
+/** Allocations below this stay on the C heap */
+#define HUGE_MIN_BYTES		HUGE_PAGE_SIZE
+
+/** Environment variable picking the mode */
+#define HUGE_ENV		"HUGEMEM"
+
+/** How large allocations are backed */
+typedef enum _huge_mode
+{
+	HUGE_SYSTEM = 0,	/**< no advice, the system THP policy decides */
+	HUGE_OFF,		/**< MADV_NOHUGEPAGE, base pages only */
+	HUGE_THP,		/**< MADV_HUGEPAGE, transparent huge pages */
+	HUGE_HUGETLB,		/**< MAP_HUGETLB from the reserved pool, else HUGE_THP */
+	HUGE_MODE_COUNT
+}huge_mode;
+
+extern const char *huge_mode_name[HUGE_MODE_COUNT];
+
+/**
+	\brief struct huge_stats: bytes handed out by each kind of backing
+	       since the program started
+*/
+typedef struct huge_stats
+{
+	/** Explicit huge pages (MAP_HUGETLB) */
+	size_t hugetlb;
+	/** Mappings advised MADV_HUGEPAGE; the kernel may still use base pages */
+	size_t thp;
+	/** Mappings left on base pages, or to the system policy */
+	size_t base;
+	/** MAP_HUGETLB attempts that fell back, pool empty or not configured */
+	size_t fallbacks;
+}huge_stats;
+
+/*!*******************************************************
+*	\fn huge_set_mode(huge_mode mode)
+*	\brief - set the backing for later allocations, overriding $HUGEMEM
+*	\param mode - new mode
+*	\return void
+*********************************************************/
+void huge_set_mode(huge_mode mode);
+
+/*!*******************************************************
+*	\fn huge_get_mode(void)
+*	\brief - backing used for the next large allocation
+*	\return huge_mode - current mode
+*********************************************************/
+huge_mode huge_get_mode(void);
+
+/*!*******************************************************
+*	\fn huge_alloc(size_t len)
+*	\brief - allocate len bytes, cache line aligned, huge page backed
+*		 if len is at least HUGE_MIN_BYTES
+*	\param len - bytes
+*	\return void * - block, NULL if out of memory
+*********************************************************/
+void* huge_alloc(size_t len);
+
+/*!*******************************************************
+*	\fn huge_realloc(void *p, size_t old_len, size_t len)
+*	\brief - resize a huge_alloc() block, keeping its contents. A large
+*		 block that still fits its 2 MB pages stays where it is.
+*	\param p - block, or NULL for a new one
+*	\param old_len - size p was allocated with
+*	\param len - new size
+*	\return void * - block, NULL if out of memory (p is left as it was)
+*********************************************************/
+void* huge_realloc(void *p, size_t old_len, size_t len);
+
+/*!*******************************************************
+*	\fn huge_free(void *p, size_t len)
+*	\brief - release a huge_alloc() block
+*	\param p - block, may be NULL
+*	\param len - size it was allocated (or last resized) with
+*	\return void
+*********************************************************/
+void huge_free(void *p, size_t len);
+
+/*!*******************************************************
+*	\fn huge_get_stats(huge_stats *st)
+*	\brief - copy out the allocation counters
+*	\param st - out: counters
+*	\return void
+*********************************************************/
+void huge_get_stats(huge_stats *st);
+
+#endif /* _HUGEMEM_H_ */
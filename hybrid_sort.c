@@ -0,0 +1,277 @@
+/**
+* @file hybrid_sort.c
+* @brief Introsort, LSD radix sort and the dispatcher choosing between them
+*/
+
+#include <stdint.h>
+#include "hybrid_sort.h"
+#include "heap_generic.h"
+#include "adaptive_sort.h"
+#include "simd_sort.h"
+#include "hugemem.h"
+
+GEN_HEAP(hint, int, KEY_LT)
+
+/** Radix digit width and bucket count */
+#define RADIX_BITS	(8)
+#define RADIX_BUCKETS	(1 << RADIX_BITS)
+#define RADIX_PASSES	((int)(sizeof(int) * 8 / RADIX_BITS))
+
+const char *hybrid_plan_name[HYBRID_PLAN_COUNT] = {"network", "adaptive", "radix", "introsort"};
+
+/*!*******************************************************
+*	\fn median3(int *a, size_t lo, size_t hi)
+*	\brief - order a[lo], a[mid], a[hi] and return the median
+*	\param a - array
+*	\param lo - first index
+*	\param hi - last index
+*	\return int - pivot value, also left in a[mid]
+*********************************************************/
+static int median3(int *a, size_t lo, size_t hi)
+{
+	size_t mid = lo + ((hi - lo) / 2);
+	int t = 0;
+
+	if(a[mid] < a[lo])
+	{
+		t = a[mid]; a[mid] = a[lo]; a[lo] = t;
+	}
+	if(a[hi] < a[mid])
+	{
+		t = a[hi]; a[hi] = a[mid]; a[mid] = t;
+		if(a[mid] < a[lo])
+		{
+			t = a[mid]; a[mid] = a[lo]; a[lo] = t;
+		}
+	}
+	return (a[mid]);
+}
+
+/*!*******************************************************
+*	\fn intro_loop(int *a, size_t n, int depth)
+*	\brief - introsort body. Recurses into the smaller side and loops on
+*		 the larger one, so the stack stays O(log n) deep.
+*	\param a - range to sort
+*	\param n - length of the range
+*	\param depth - partitions left before switching to heapsort
+*	\return void
+*	\note FUNCTION IS RECURSIVE
+*********************************************************/
+static void intro_loop(int *a, size_t n, int depth)
+{
+	size_t i = 0;
+	size_t j = 0;
+	int pivot = 0;
+	int t = 0;
+
+	while(n > HYBRID_LEAF)
+	{
+		if(0 == depth--)
+		{
+			/* Adversarial or unlucky pivots: the heap engine bounds it */
+			hint_heapsort(a, n);
+			return;
+		}
+
+		/* Hoare partition around the median of 3. Values equal to the
+		   pivot stop both scans, so runs of equal keys split evenly. */
+		pivot = median3(a, 0, n - 1);
+		i = 0;
+		j = n - 1;
+		while(1)
+		{
+			while(a[i] < pivot)
+				i++;
+			while(pivot < a[j])
+				j--;
+			if(i >= j)
+				break;
+			t = a[i]; a[i] = a[j]; a[j] = t;
+			i++;
+			j--;
+		}
+
+		/* a[0..j] <= pivot <= a[j+1..n) */
+		if((j + 1) < (n - j - 1))
+		{
+			intro_loop(a, j + 1, depth);
+			a += j + 1;
+			n -= j + 1;
+		}
+		else
+		{
+			intro_loop(a + j + 1, n - j - 1, depth);
+			n = j + 1;
+		}
+	}
+	simd_sort(a, n);
+}
+
+/*!*******************************************************
+*	\fn intro_sort(int *a, size_t n)
+*	\brief - median of 3 quicksort, ranges of HYBRID_LEAF or fewer go to
+*		 the sorting network and ranges deeper than 2 log2(n) to
+*		 heapsort. In place, O(n log n) worst case.
+*	\param a - array to sort
+*	\param n - number of elements
+*	\return void
+*********************************************************/
+void intro_sort(int *a, size_t n)
+{
+	int depth = 0;
+	size_t m = n;
+
+	while(m > 1)
+	{
+		depth += 2;
+		m >>= 1;
+	}
+	intro_loop(a, n, depth);
+}
+
+/*!*******************************************************
+*	\fn radix_sort(int *a, size_t n)
+*	\brief - LSD radix sort, 8 bits per pass. All four histograms come
+*		 from one read of the input and passes whose byte is the same
+*		 for every value are skipped.
+*	\param a - array to sort
+*	\param n - number of elements
+*	\return bool - FALSE if out of memory (a[] is then left unsorted)
+*********************************************************/
+bool radix_sort(int *a, size_t n)
+{
+	size_t (*count)[RADIX_BUCKETS] = NULL;
+	uint32_t *src = (uint32_t*) a;
+	uint32_t *dst = NULL;
+	uint32_t *t = NULL;
+	uint32_t key = 0;
+	size_t sum = 0;
+	size_t c = 0;
+	size_t i = 0;
+	int pass = 0;
+	int shift = 0;
+
+	if(n < 2)
+		return (TRUE);
+	dst = (uint32_t*) huge_alloc(n * sizeof(*dst));
+	count = calloc(RADIX_PASSES, sizeof(*count));
+	if((NULL == dst) || (NULL == count))
+	{
+		huge_free(dst, n * sizeof(*dst));
+		free(count);
+		return (FALSE);
+	}
+
+	/* Flipping the sign bit makes signed order match unsigned order */
+	for(i = 0; i < n; i++)
+	{
+		key = src[i] ^ 0x80000000u;
+		for(pass = 0; pass < RADIX_PASSES; pass++)
+			count[pass][(key >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++;
+	}
+
+	for(pass = 0; pass < RADIX_PASSES; pass++)
+	{
+		shift = pass * RADIX_BITS;
+		/* Every value has the same digit here, the pass would only copy */
+		if(n == count[pass][(((uint32_t) a[0] ^ 0x80000000u) >> shift) & (RADIX_BUCKETS - 1)])
+			continue;
+
+		for(i = 0, sum = 0; i < RADIX_BUCKETS; i++)
+		{
+			c = count[pass][i];
+			count[pass][i] = sum;
+			sum += c;
+		}
+		for(i = 0; i < n; i++)
+		{
+			key = src[i] ^ 0x80000000u;
+			dst[count[pass][(key >> shift) & (RADIX_BUCKETS - 1)]++] = src[i];
+		}
+		t = src;
+		src = dst;
+		dst = t;
+	}
+
+	/* An odd number of passes leaves the result in the scratch buffer */
+	if(src != (uint32_t*) a)
+	{
+		memcpy(a, src, n * sizeof(*a));
+		dst = src;
+	}
+	huge_free(dst, n * sizeof(*dst));
+	free(count);
+	return (TRUE);
+}
+
+/*!*******************************************************
+*	\fn hybrid_choose(const int *a, size_t n)
+*	\brief - pick the algorithm for a[] from its size and a sample of
+*		 HYBRID_SAMPLE evenly spaced values
+*	\param a - array to be sorted
+*	\param n - number of elements
+*	\return hybrid_plan - algorithm hybrid_sort() would run
+*********************************************************/
+hybrid_plan hybrid_choose(const int *a, size_t n)
+{
+	size_t step = 0;
+	size_t i = 0;
+	size_t up = 0;
+	size_t down = 0;
+
+	if(n <= SIMD_SORT_MAX)
+		return (HYBRID_NETWORK);
+
+	/* A sample that never (or only once) changes direction means long
+	   runs; adaptive_sort() confirms with its own full scan and still
+	   heapsorts if the sample was a fluke */
+	step = n / HYBRID_SAMPLE;
+	for(i = step; i < (HYBRID_SAMPLE * step); i += step)
+	{
+		up += (a[i - step] < a[i]);
+		down += (a[i] < a[i - step]);
+	}
+	if((up <= 1) || (down <= 1))
+		return (HYBRID_ADAPTIVE);
+
+	if(n >= HYBRID_RADIX_MIN)
+		return (HYBRID_RADIX);
+	return (HYBRID_INTRO);
+}
+
+/*!*******************************************************
+*	\fn hybrid_sort(int *a, size_t n)
+*	\brief - sort a[] ascending with the algorithm hybrid_choose() picks.
+*		 Falls back to intro_sort() if the chosen one runs out of memory.
+*	\param a - array to sort
+*	\param n - number of elements
+*	\return hybrid_plan - algorithm that did the sort
+*********************************************************/
+hybrid_plan hybrid_sort(int *a, size_t n)
+{
+	hybrid_plan plan = hybrid_choose(a, n);
+	bool ok = TRUE;
+
+	switch(plan)
+	{
+		case HYBRID_NETWORK:
+			ok = simd_sort(a, n);
+			break;
+		case HYBRID_ADAPTIVE:
+			ok = adaptive_sort(a, n);
+			break;
+		case HYBRID_RADIX:
+			ok = radix_sort(a, n);
+			break;
+		default:
+			break;
+	}
+	if((HYBRID_INTRO == plan) || (FALSE == ok))
+	{
+		PRINT("hybrid_sort: %zu values, introsort\n", n);
+		intro_sort(a, n);
+		return (HYBRID_INTRO);
+	}
+	PRINT("hybrid_sort: %zu values, %s\n", n, hybrid_plan_name[plan]);
+	return (plan);
+}
@@ -0,0 +1,79 @@
+/**
+* @file hybrid_sort.h
+* @brief Sort front end that picks an algorithm per input. Small inputs
+*        go to the sorting networks, presorted ones to adaptive_sort(),
+*        large ones to an LSD radix sort, and everything else to introsort,
+*        a quicksort that hands any range recursing too deep to the heap
+*        engine, so no input takes longer than O(n log n).
+*/
+
+#ifndef _HYBRID_SORT_H_
+#define _HYBRID_SORT_H_
+
+#include "heapsort.h"
+
+/** Ranges this small are finished by the sorting network */
+#define HYBRID_LEAF		(64)
+
+/** Inputs this large are radix sorted, if the scratch buffer can be had */
+#define HYBRID_RADIX_MIN	(1 << 16)
+
+/** Values sampled to look for existing order */
+#define HYBRID_SAMPLE		(64)
+
+/** Algorithms hybrid_sort() chooses between */
+typedef enum _hybrid_plan
+{
+	HYBRID_NETWORK = 0,	/**< simd_sort(), n <= SIMD_SORT_MAX */
+	HYBRID_ADAPTIVE,	/**< adaptive_sort(), the sample is in order */
+	HYBRID_RADIX,		/**< radix_sort(), n >= HYBRID_RADIX_MIN */
+	HYBRID_INTRO,		/**< intro_sort() */
+	HYBRID_PLAN_COUNT
+}hybrid_plan;
+
+/** Printable plan names, indexed by hybrid_plan */
+extern const char *hybrid_plan_name[HYBRID_PLAN_COUNT];
+
+/*!*******************************************************
+*	\fn hybrid_choose(const int *a, size_t n)
+*	\brief - pick the algorithm for a[] from its size and a sample of
+*		 HYBRID_SAMPLE evenly spaced values
+*	\param a - array to be sorted
+*	\param n - number of elements
+*	\return hybrid_plan - algorithm hybrid_sort() would run
+*********************************************************/
+hybrid_plan hybrid_choose(const int *a, size_t n);
+
+/*!*******************************************************
+*	\fn hybrid_sort(int *a, size_t n)
+*	\brief - sort a[] ascending with the algorithm hybrid_choose() picks.
+*		 Falls back to intro_sort() if the chosen one runs out of memory.
+*	\param a - array to sort
+*	\param n - number of elements
+*	\return hybrid_plan - algorithm that did the sort
+*********************************************************/
+hybrid_plan hybrid_sort(int *a, size_t n);
+
+/*!*******************************************************
+*	\fn intro_sort(int *a, size_t n)
+*	\brief - median of 3 quicksort, ranges of HYBRID_LEAF or fewer go to
+*		 the sorting network and ranges deeper than 2 log2(n) to
+*		 heapsort. In place, O(n log n) worst case.
+*	\param a - array to sort
+*	\param n - number of elements
+*	\return void
+*********************************************************/
+void intro_sort(int *a, size_t n);
+
+/*!*******************************************************
+*	\fn radix_sort(int *a, size_t n)
+*	\brief - LSD radix sort, 8 bits per pass. All four histograms come
+*		 from one read of the input and passes whose byte is the same
+*		 for every value are skipped.
+*	\param a - array to sort
+*	\param n - number of elements
+*	\return bool - FALSE if out of memory (a[] is then left unsorted)
+*********************************************************/
+bool radix_sort(int *a, size_t n);
+
+#endif // _HYBRID_SORT_H_
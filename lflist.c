@@ -0,0 +1,240 @@
+/**
+* @file lflist.c
+* @brief Harris/Michael lock-free sorted list with epoch reclamation
+*/
+
+#include "lflist.h"
+
+/** Node pointer without the mark bit */
+#define LF_PTR(p)	((lf_node*)((p) & ~LF_MARK))
+
+/*!*******************************************************
+*	\fn lf_free(void *p)
+*	\brief - epoch_free_fn for list nodes
+*	\param p - node
+*	\return void
+*********************************************************/
+static void lf_free(void *p)
+{
+	free(p);
+}
+
+/*!*******************************************************
+*	\fn lflist_init(lflist *l, int max_threads)
+*	\brief - set up an empty list
+*	\param l - list
+*	\param max_threads - threads that will register
+*	\return bool - FALSE if out of memory
+*********************************************************/
+bool lflist_init(lflist *l, int max_threads)
+{
+	atomic_init(&l->head.next, (uintptr_t) NULL);
+	l->head.data = 0;
+	return (epoch_init(&l->ep, max_threads, lf_free));
+}
+
+/*!*******************************************************
+*	\fn lflist_register(lflist *l)
+*	\brief - register the calling thread
+*	\param l - list
+*	\return int - thread id for the other calls, -1 if too many threads
+*********************************************************/
+int lflist_register(lflist *l)
+{
+	return (epoch_register(&l->ep));
+}
+
+/*!*******************************************************
+*	\fn lf_search(lflist *l, int tid, int data, _Atomic uintptr_t **prev_out)
+*	\brief - find the first node not larger than data, unlinking any
+*		 deleted nodes on the way. Must be called inside a read section.
+*	\param l - list
+*	\param tid - id from lflist_register()
+*	\param data - value to look for
+*	\param prev_out - out: link that points at the returned node
+*	\return lf_node * - first node with node->data <= data, NULL if none
+*********************************************************/
+static lf_node* lf_search(lflist *l, int tid, int data, _Atomic uintptr_t **prev_out)
+{
+	_Atomic uintptr_t *prev = NULL;
+	lf_node *curr = NULL;
+	uintptr_t next = 0;
+
+retry:
+	prev = &l->head.next;
+	curr = LF_PTR(atomic_load(prev));
+	while(NULL != curr)
+	{
+		next = atomic_load(&curr->next);
+		if(0 != (next & LF_MARK))
+		{
+			/* curr is deleted: unlink it. Failing means prev changed
+			   under us (or got deleted itself), start over. */
+			uintptr_t expect = (uintptr_t) curr;
+			if(!atomic_compare_exchange_strong(prev, &expect, next & ~LF_MARK))
+				goto retry;
+			epoch_retire(&l->ep, tid, curr);
+			curr = LF_PTR(next);
+			continue;
+		}
+		/* Descending order, same as insert_node() */
+		if(curr->data <= data)
+			break;
+		prev = &curr->next;
+		curr = LF_PTR(next);
+	}
+	*prev_out = prev;
+	return (curr);
+}
+
+/*!*******************************************************
+*	\fn lf_link(lflist *l, int tid, int data, bool unique)
+*	\brief - link a new node holding data in front of the first node not
+*		 larger than it
+*	\param l - list
+*	\param tid - id from lflist_register()
+*	\param data - value to insert
+*	\param unique - TRUE to give up if data is already present
+*	\return bool - FALSE if out of memory or (unique) already present
+*********************************************************/
+static bool lf_link(lflist *l, int tid, int data, bool unique)
+{
+	lf_node *n = (lf_node*) malloc(sizeof(*n));
+	_Atomic uintptr_t *prev = NULL;
+	lf_node *curr = NULL;
+	uintptr_t expect = 0;
+
+	if(NULL == n)
+		return (FALSE);
+	n->data = data;
+
+	epoch_enter(&l->ep, tid);
+	do
+	{
+		curr = lf_search(l, tid, data, &prev);
+		if((TRUE == unique) && (NULL != curr) && (curr->data == data))
+		{
+			epoch_exit(&l->ep, tid);
+			free(n);
+			return (FALSE);
+		}
+		atomic_store_explicit(&n->next, (uintptr_t) curr, memory_order_relaxed);
+		expect = (uintptr_t) curr;
+	}while(!atomic_compare_exchange_strong(prev, &expect, (uintptr_t) n));
+	epoch_exit(&l->ep, tid);
+	return (TRUE);
+}
+
+/*!*******************************************************
+*	\fn lflist_insert(lflist *l, int tid, int data)
+*	\brief - insert_node() for the concurrent list
+*	\param l - list
+*	\param tid - id from lflist_register()
+*	\param data - value to insert
+*	\return bool - FALSE if out of memory
+*********************************************************/
+bool lflist_insert(lflist *l, int tid, int data)
+{
+	return (lf_link(l, tid, data, FALSE));
+}
+
+/*!*******************************************************
+*	\fn lflist_add(lflist *l, int tid, int data)
+*	\brief - insert data unless it is already present (set semantics)
+*	\param l - list
+*	\param tid - id from lflist_register()
+*	\param data - value to insert
+*	\return bool - FALSE if already present or out of memory
+*********************************************************/
+bool lflist_add(lflist *l, int tid, int data)
+{
+	return (lf_link(l, tid, data, TRUE));
+}
+
+/*!*******************************************************
+*	\fn lflist_delete(lflist *l, int tid, int data)
+*	\brief - delete_node() for the concurrent list, removes one
+*		 node holding data
+*	\param l - list
+*	\param tid - id from lflist_register()
+*	\param data - value to delete
+*	\return bool - FALSE if data was not in the list
+*********************************************************/
+bool lflist_delete(lflist *l, int tid, int data)
+{
+	_Atomic uintptr_t *prev = NULL;
+	lf_node *curr = NULL;
+	uintptr_t next = 0;
+	uintptr_t expect = 0;
+	bool found = FALSE;
+
+	epoch_enter(&l->ep, tid);
+	while(1)
+	{
+		curr = lf_search(l, tid, data, &prev);
+		if((NULL == curr) || (curr->data != data))
+			break;
+
+		/* Logical delete: mark curr's next. Losing the race means curr
+		   was deleted or got a new successor, look again. */
+		next = atomic_load(&curr->next);
+		if(0 != (next & LF_MARK))
+			continue;
+		if(!atomic_compare_exchange_strong(&curr->next, &next, next | LF_MARK))
+			continue;
+
+		/* Physical delete; if it fails a search will finish the job */
+		found = TRUE;
+		expect = (uintptr_t) curr;
+		if(atomic_compare_exchange_strong(prev, &expect, next))
+			epoch_retire(&l->ep, tid, curr);
+		else
+			lf_search(l, tid, data, &prev);
+		break;
+	}
+	epoch_exit(&l->ep, tid);
+	return (found);
+}
+
+/*!*******************************************************
+*	\fn lflist_find(lflist *l, int tid, int data)
+*	\brief - look for data
+*	\param l - list
+*	\param tid - id from lflist_register()
+*	\param data - value to look for
+*	\return bool - TRUE if present
+*********************************************************/
+bool lflist_find(lflist *l, int tid, int data)
+{
+	_Atomic uintptr_t *prev = NULL;
+	lf_node *curr = NULL;
+	bool found = FALSE;
+
+	epoch_enter(&l->ep, tid);
+	curr = lf_search(l, tid, data, &prev);
+	found = ((NULL != curr) && (curr->data == data)) ? TRUE : FALSE;
+	epoch_exit(&l->ep, tid);
+	return (found);
+}
+
+/*!*******************************************************
+*	\fn lflist_free(lflist *l)
+*	\brief - free_link_nodes() for the concurrent list. No thread may
+*		 be using it any more.
+*	\param l - list
+*	\return void
+*********************************************************/
+void lflist_free(lflist *l)
+{
+	lf_node *iter = LF_PTR(atomic_load(&l->head.next));
+	lf_node *mem = NULL;
+
+	while(NULL != iter)
+	{
+		mem = LF_PTR(atomic_load(&iter->next));
+		free(iter);
+		iter = mem;
+	}
+	atomic_store(&l->head.next, (uintptr_t) NULL);
+	epoch_destroy(&l->ep);
+}
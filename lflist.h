@@ -0,0 +1,108 @@
+/**
+* @file lflist.h
+* @brief Lock-free sorted linked list (Harris/Michael). Same ordering as
+*        insert_node() in llist.c (descending, duplicates allowed), but any
+*        number of threads may insert, delete and search at once.
+*
+*        A delete first sets the low bit of the victim's next pointer
+*        (logical delete), which stops anyone linking behind it, and then
+*        swings the predecessor past it. Searches help unlink marked nodes
+*        they pass. Unlinked nodes are freed through epoch.h.
+*/
+
+#ifndef _LFLIST_H_
+#define _LFLIST_H_
+
+#include <stdint.h>
+#include "epoch.h"
+
+/** Low bit of a next pointer: the node owning the pointer is deleted */
+#define LF_MARK			((uintptr_t) 1)
+
+/**
+	\brief struct lf_node: list node; next carries the delete mark
+*/
+typedef struct lf_node
+{
+	_Atomic uintptr_t next;
+	int data;
+}lf_node;
+
+/**
+	\brief struct lflist: list handle
+*/
+typedef struct lflist
+{
+	/** Sentinel, its next is the first real node */
+	_Alignas(64) lf_node head;
+	epoch_domain ep;
+}lflist;
+
+/*!*******************************************************
+*	\fn lflist_init(lflist *l, int max_threads)
+*	\brief - set up an empty list
+*	\param l - list
+*	\param max_threads - threads that will register
+*	\return bool - FALSE if out of memory
+*********************************************************/
+bool lflist_init(lflist *l, int max_threads);
+
+/*!*******************************************************
+*	\fn lflist_register(lflist *l)
+*	\brief - register the calling thread
+*	\param l - list
+*	\return int - thread id for the other calls, -1 if too many threads
+*********************************************************/
+int lflist_register(lflist *l);
+
+/*!*******************************************************
+*	\fn lflist_insert(lflist *l, int tid, int data)
+*	\brief - insert_node() for the concurrent list
+*	\param l - list
+*	\param tid - id from lflist_register()
+*	\param data - value to insert
+*	\return bool - FALSE if out of memory
+*********************************************************/
+bool lflist_insert(lflist *l, int tid, int data);
+
+/*!*******************************************************
+*	\fn lflist_add(lflist *l, int tid, int data)
+*	\brief - insert data unless it is already present (set semantics)
+*	\param l - list
+*	\param tid - id from lflist_register()
+*	\param data - value to insert
+*	\return bool - FALSE if already present or out of memory
+*********************************************************/
+bool lflist_add(lflist *l, int tid, int data);
+
+/*!*******************************************************
+*	\fn lflist_delete(lflist *l, int tid, int data)
+*	\brief - delete_node() for the concurrent list, removes one
+*		 node holding data
+*	\param l - list
+*	\param tid - id from lflist_register()
+*	\param data - value to delete
+*	\return bool - FALSE if data was not in the list
+*********************************************************/
+bool lflist_delete(lflist *l, int tid, int data);
+
+/*!*******************************************************
+*	\fn lflist_find(lflist *l, int tid, int data)
+*	\brief - look for data
+*	\param l - list
+*	\param tid - id from lflist_register()
+*	\param data - value to look for
+*	\return bool - TRUE if present
+*********************************************************/
+bool lflist_find(lflist *l, int tid, int data);
+
+/*!*******************************************************
+*	\fn lflist_free(lflist *l)
+*	\brief - free_link_nodes() for the concurrent list. No thread may
+*		 be using it any more.
+*	\param l - list
+*	\return void
+*********************************************************/
+void lflist_free(lflist *l);
+
+#endif // _LFLIST_H_
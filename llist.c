@@ -1,4 +1,7 @@
 #include "heapsort.h"
+#ifdef TRACE
+ #include "trace.h"
+#endif /* TRACE */
 
 typedef void (*fnptr) (node **, int, node*);
 
@@ -84,7 +87,7 @@ void free_link_nodes(node **head, int data, node *dontcare)
 *******************************************************************/
 void insert_node(node **head, int data, node *dontcare)
 {
-	printf("Inserting data %d\n", data);
+	PRINT("Inserting data %d\n", data);
 	node *iter = *head;
 	node *prev = NULL;
 
@@ -109,10 +112,16 @@ void insert_node(node **head, int data, node *dontcare)
 			break;
 	}
 
-	// This means we are at the end of the list.. re-acquire the last node
+	// This means we are at the end of the list.. the new node goes
+	// after the last one
 	if(NULL == iter)
 	{
-		iter = prev;
+		node *new_node = new();
+		new_node->data = data;
+		new_node->link[PREV] = prev;
+		new_node->link[NEXT] = NULL;
+		prev->link[NEXT] = new_node;
+		return;
 	}
 
 	node *new_node = new();
@@ -123,6 +132,7 @@ void insert_node(node **head, int data, node *dontcare)
 	{
 		new_node->link[PREV] = NULL;
 		new_node->link[NEXT] = *head;
+		(*head)->link[PREV] = new_node;
 		(*head) = new_node; 
 	}
 	else
@@ -158,35 +168,54 @@ void delete_node(node **head, int data, node *dontcare)
 			break;
 	}
 
+	// Not in the list
+	if(NULL == iter)
+		return;
+
 	// Modifying head.. edit *ptr value so caller sees the changed head
 	if(NULL == iter->link[PREV])
 	{
 		// This is the head, make next node the head
 		iter = *head;
 		*head = (*head)->link[NEXT];
-		(*head)->link[PREV] = NULL; //Since this is the new head, make prev=NULL
 		free(iter);
-		printf("Deleted %d, %d is now head\n", data, (*head)->data);
+		if(NULL == *head)
+		{
+			PRINT("Deleted %d, list is now empty\n", data);
+			return;
+		}
+		(*head)->link[PREV] = NULL; //Since this is the new head, make prev=NULL
+		PRINT("Deleted %d, %d is now head\n", data, (*head)->data);
 		return;
 	}
 	else
 	{
 		(iter->link[PREV])->link[NEXT] = iter->link[NEXT];
-		printf("relaid out prev->next link to %p\n", iter->link[PREV]->link[NEXT]);
+		PRINT("relaid out prev->next link to %p\n", iter->link[PREV]->link[NEXT]);
 		if(NULL != iter->link[NEXT])
 		{
 			(iter->link[NEXT])->link[PREV] = iter->link[PREV];
 		}
-		printf("free'ing node %d\n", data);
+		PRINT("free'ing node %d\n", data);
 		free(iter);
 	}
 }
 
-
+#ifndef LLIST_NO_MAIN
+/*******************************************************************
+	\fn main
+	\brief - interactive list driver. Build with -DLLIST_NO_MAIN to
+		 link the list functions into another program.
+*******************************************************************/
 int main()
 {
 	unsigned int opt = 0;
 	int data = 0;
+#ifdef TRACE
+	/* Menu option -> recorded operation, $TRACE_FILE names the file */
+	static const trace_op opt_trace[] = {TRACE_INSERT, TRACE_APPEND, TRACE_DELETE, TRACE_PRINT};
+	trace_writer *tw = trace_open_env();
+#endif /* TRACE */
 
 	node *head = NULL;
 
@@ -198,11 +227,14 @@ int main()
 			\n3)Delete \
 			\n4)Print \
 			\n5)Quit\n");
-		scanf("%d", &opt);
+		/* EOF or a non-number would be read again forever */
+		if(1 != scanf("%u", &opt))
+			break;
 
       if(5 == opt)
          break;
-		else if((5 < opt))
+		/* opt indexes fn_arr and opt_trace from 1 */
+		else if((0 == opt) || (5 < opt))
 			continue;
       else if(4 != opt)
 		{
@@ -210,7 +242,14 @@ int main()
 			scanf("%d",&data);
 		}
 
+#ifdef TRACE
+		trace_record(tw, opt_trace[opt-1], data);
+#endif /* TRACE */
 		fn_arr[opt-1](&head, data, head);
 	}
+#ifdef TRACE
+	trace_close(tw);
+#endif /* TRACE */
 	return 0;
 }
+#endif /* !LLIST_NO_MAIN */
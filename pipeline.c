@@ -0,0 +1,390 @@
+/**
+* @file pipeline.c
+* @brief Producer/consumer ingest pipeline: lock-free batch ring, parser
+*        stage and writer stage
+*/
+
+#include <sched.h>
+#include "pipeline.h"
+
+/** Bytes pulled from the input stream per read */
+#define PIPE_READ_CHUNK		(64 * 1024)
+
+/*!*******************************************************
+*	\fn ring_wait(pipe_ring *ring, _Atomic size_t *idx, size_t old)
+*	\brief - wait for the other side to move idx off old. Polls a
+*		 bounded number of times, then sleeps on the ring's condition
+*		 variable so a stage blocked on I/O on the other end doesn't
+*		 cost a whole core.
+*	\param ring - ring
+*	\param idx - head or tail, owned by the other side
+*	\param old - value to wait out
+*	\return void
+*********************************************************/
+static void ring_wait(pipe_ring *ring, _Atomic size_t *idx, size_t old)
+{
+	int spin = 0;
+
+	for(spin = 0; spin < PIPE_SPIN; spin++)
+	{
+		if(atomic_load_explicit(idx, memory_order_acquire) != old)
+			return;
+	}
+
+	/* waiters goes up before idx is checked again, and ring_wake() stores
+	   idx before it reads waiters; both seq_cst, so either we see the new
+	   idx or the other side sees us and signals under the lock */
+	pthread_mutex_lock(&ring->lock);
+	atomic_fetch_add(&ring->waiters, 1);
+	while(atomic_load(idx) == old)
+		pthread_cond_wait(&ring->cond, &ring->lock);
+	atomic_fetch_sub(&ring->waiters, 1);
+	pthread_mutex_unlock(&ring->lock);
+}
+
+/*!*******************************************************
+*	\fn ring_wake(pipe_ring *ring)
+*	\brief - wake the other side if it has parked, after head or tail
+*		 has been stored
+*	\param ring - ring
+*	\return void
+*********************************************************/
+static void ring_wake(pipe_ring *ring)
+{
+	if(0 != atomic_load(&ring->waiters))
+	{
+		pthread_mutex_lock(&ring->lock);
+		pthread_cond_broadcast(&ring->cond);
+		pthread_mutex_unlock(&ring->lock);
+	}
+}
+
+/*!*******************************************************
+*	\fn ring_acquire_write(pipe_ring *ring)
+*	\brief - wait for a free slot and return it for filling
+*	\param ring - ring to write to
+*	\return pipe_batch * - free slot
+*********************************************************/
+static pipe_batch* ring_acquire_write(pipe_ring *ring)
+{
+	size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+	/* Ring is full while the consumer is a whole lap behind */
+	while((tail - atomic_load_explicit(&ring->head, memory_order_acquire)) == PIPE_RING_SLOTS)
+		ring_wait(ring, &ring->head, tail - PIPE_RING_SLOTS);
+	return (&ring->slot[tail & (PIPE_RING_SLOTS - 1)]);
+}
+
+/*!*******************************************************
+*	\fn ring_publish(pipe_ring *ring)
+*	\brief - make the slot returned by ring_acquire_write() visible to the consumer
+*	\param ring - ring written to
+*	\return void
+*********************************************************/
+static void ring_publish(pipe_ring *ring)
+{
+	size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	atomic_store(&ring->tail, tail + 1);
+	ring_wake(ring);
+}
+
+/*!*******************************************************
+*	\fn ring_acquire_read(pipe_ring *ring)
+*	\brief - wait for a published slot and return it
+*	\param ring - ring to read from
+*	\return pipe_batch * - oldest published slot
+*********************************************************/
+static pipe_batch* ring_acquire_read(pipe_ring *ring)
+{
+	size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+	while(head == atomic_load_explicit(&ring->tail, memory_order_acquire))
+		ring_wait(ring, &ring->tail, head);
+	return (&ring->slot[head & (PIPE_RING_SLOTS - 1)]);
+}
+
+/*!*******************************************************
+*	\fn ring_release(pipe_ring *ring)
+*	\brief - hand the slot returned by ring_acquire_read() back to the producer
+*	\param ring - ring read from
+*	\return void
+*********************************************************/
+static void ring_release(pipe_ring *ring)
+{
+	size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	atomic_store(&ring->head, head + 1);
+	ring_wake(ring);
+}
+
+/*!*******************************************************
+*	\fn new_stage(FILE *fp, bool writer)
+*	\brief - allocate and initialize a stage
+*	\param fp - stream owned by the stage thread
+*	\param writer - TRUE for the writer stage
+*	\return pipe_stage * - new stage, NULL if out of memory
+*********************************************************/
+static pipe_stage* new_stage(FILE *fp, bool writer)
+{
+	pipe_stage *stage = (pipe_stage*) malloc(sizeof(*stage));
+	if(NULL != stage)
+	{
+		atomic_init(&stage->ring.head, 0);
+		atomic_init(&stage->ring.tail, 0);
+		atomic_init(&stage->ring.waiters, 0);
+		pthread_mutex_init(&stage->ring.lock, NULL);
+		pthread_cond_init(&stage->ring.cond, NULL);
+		stage->fp = fp;
+		stage->cur = NULL;
+		stage->writer = writer;
+		stage->done = FALSE;
+	}
+	return (stage);
+}
+
+/*!*******************************************************
+*	\fn free_stage(pipe_stage *stage)
+*	\brief - release a stage whose thread has exited or never started
+*	\param stage - stage
+*	\return void
+*********************************************************/
+static void free_stage(pipe_stage *stage)
+{
+	pthread_mutex_destroy(&stage->ring.lock);
+	pthread_cond_destroy(&stage->ring.cond);
+	free(stage);
+}
+
+/*!*******************************************************
+*	\fn parser_main(void *arg)
+*	\brief - parser thread. Reads the stream in large chunks and
+*		 converts it to ints by hand; a number may straddle two
+*		 chunks, so the partial value is carried over.
+*	\param arg - parser stage
+*	\return NULL
+*********************************************************/
+static void* parser_main(void *arg)
+{
+	pipe_stage *stage = (pipe_stage*) arg;
+	char *buf = (char*) malloc(PIPE_READ_CHUNK);
+	pipe_batch *batch = ring_acquire_write(&stage->ring);
+	size_t len = 0;
+	size_t i = 0;
+	bool in_num = FALSE;
+	bool neg = FALSE;
+	bool end = FALSE;
+	int val = 0;
+
+	batch->count = 0;
+	while((FALSE == end) && (NULL != buf))
+	{
+		len = fread(buf, 1, PIPE_READ_CHUNK, stage->fp);
+		if(0 == len)
+		{
+			/* EOF: one blank terminates a number running up to the end */
+			buf[0] = ' ';
+			len = 1;
+			end = TRUE;
+		}
+		for(i = 0; i < len; i++)
+		{
+			char c = buf[i];
+			if((c >= '0') && (c <= '9'))
+			{
+				val = (val * 10) + (c - '0');
+				in_num = TRUE;
+				continue;
+			}
+			if(TRUE == in_num)
+			{
+				if(TRUE == neg)
+					val = -val;
+				if(PIPE_END_MARKER == val)
+				{
+					end = TRUE;
+					break;
+				}
+				batch->vals[batch->count++] = val;
+				if(PIPE_BATCH == batch->count)
+				{
+					ring_publish(&stage->ring);
+					batch = ring_acquire_write(&stage->ring);
+					batch->count = 0;
+				}
+			}
+			/* Only a '-' directly in front of a digit makes it negative */
+			neg = (c == '-') ? TRUE : FALSE;
+			in_num = FALSE;
+			val = 0;
+		}
+	}
+
+	/* Flush the partial batch, then an empty one to mark the end */
+	if(0 != batch->count)
+	{
+		ring_publish(&stage->ring);
+		batch = ring_acquire_write(&stage->ring);
+		batch->count = 0;
+	}
+	ring_publish(&stage->ring);
+	free(buf);
+	return (NULL);
+}
+
+/*!*******************************************************
+*	\fn pipe_start_parser(FILE *in)
+*	\brief - start a thread parsing whitespace separated ints from in,
+*		 until EOF or PIPE_END_MARKER
+*	\param in - input stream
+*	\return pipe_stage * - parser stage, NULL on failure
+*********************************************************/
+pipe_stage* pipe_start_parser(FILE *in)
+{
+	pipe_stage *stage = new_stage(in, FALSE);
+	if(NULL == stage)
+		return (NULL);
+	if(0 != pthread_create(&stage->thread, NULL, parser_main, stage))
+	{
+		free_stage(stage);
+		return (NULL);
+	}
+	return (stage);
+}
+
+/*!*******************************************************
+*	\fn pipe_next_batch(pipe_stage *stage)
+*	\brief - wait for the next parsed batch. The batch stays valid until
+*		 pipe_release_batch() is called.
+*	\param stage - parser stage
+*	\return pipe_batch * - next batch, NULL once the input is exhausted
+*********************************************************/
+pipe_batch* pipe_next_batch(pipe_stage *stage)
+{
+	pipe_batch *batch = NULL;
+	if(TRUE == stage->done)
+		return (NULL);
+
+	batch = ring_acquire_read(&stage->ring);
+	if(0 == batch->count)
+	{
+		/* End of stream, nobody needs the slot any more */
+		ring_release(&stage->ring);
+		stage->done = TRUE;
+		return (NULL);
+	}
+	return (batch);
+}
+
+/*!*******************************************************
+*	\fn pipe_release_batch(pipe_stage *stage)
+*	\brief - hand the batch returned by pipe_next_batch() back to the parser
+*	\param stage - parser stage
+*	\return void
+*********************************************************/
+void pipe_release_batch(pipe_stage *stage)
+{
+	ring_release(&stage->ring);
+}
+
+/*!*******************************************************
+*	\fn writer_main(void *arg)
+*	\brief - writer thread, prints batches until the empty end batch
+*	\param arg - writer stage
+*	\return NULL
+*********************************************************/
+static void* writer_main(void *arg)
+{
+	pipe_stage *stage = (pipe_stage*) arg;
+	pipe_batch *batch = NULL;
+	int i = 0;
+
+	while(1)
+	{
+		batch = ring_acquire_read(&stage->ring);
+		if(0 == batch->count)
+			break;
+		for(i = 0; i < batch->count; i++)
+			fprintf(stage->fp, "Extracting %d\n", batch->vals[i]);
+		ring_release(&stage->ring);
+	}
+	ring_release(&stage->ring);
+	fflush(stage->fp);
+	return (NULL);
+}
+
+/*!*******************************************************
+*	\fn pipe_start_writer(FILE *out)
+*	\brief - start a thread printing every value passed to pipe_emit()
+*	\param out - output stream
+*	\return pipe_stage * - writer stage, NULL on failure
+*********************************************************/
+pipe_stage* pipe_start_writer(FILE *out)
+{
+	pipe_stage *stage = new_stage(out, TRUE);
+	if(NULL == stage)
+		return (NULL);
+	if(0 != pthread_create(&stage->thread, NULL, writer_main, stage))
+	{
+		free_stage(stage);
+		return (NULL);
+	}
+	return (stage);
+}
+
+/*!*******************************************************
+*	\fn pipe_emit(int data, void *ctx)
+*	\brief - emit_fn for sort_emit(), queues data for the writer stage
+*	\param data - extracted value
+*	\param ctx - writer stage (pipe_stage *)
+*	\return void
+*********************************************************/
+void pipe_emit(int data, void *ctx)
+{
+	pipe_stage *stage = (pipe_stage*) ctx;
+
+	if(NULL == stage->cur)
+	{
+		stage->cur = ring_acquire_write(&stage->ring);
+		stage->cur->count = 0;
+	}
+	stage->cur->vals[stage->cur->count++] = data;
+	if(PIPE_BATCH == stage->cur->count)
+	{
+		ring_publish(&stage->ring);
+		stage->cur = NULL;
+	}
+}
+
+/*!*******************************************************
+*	\fn pipe_stop(pipe_stage *stage)
+*	\brief - flush (writer) or drain (parser) the stage, join its thread
+*		 and free it
+*	\param stage - parser or writer stage
+*	\return void
+*********************************************************/
+void pipe_stop(pipe_stage *stage)
+{
+	if(NULL == stage)
+		return;
+
+	if(TRUE == stage->writer)
+	{
+		/* Push out the partial batch, then an empty one to mark the end */
+		if((NULL != stage->cur) && (0 != stage->cur->count))
+		{
+			ring_publish(&stage->ring);
+			stage->cur = NULL;
+		}
+		if(NULL == stage->cur)
+			stage->cur = ring_acquire_write(&stage->ring);
+		stage->cur->count = 0;
+		ring_publish(&stage->ring);
+	}
+	else
+	{
+		/* Let the parser run to the end so it doesn't block on a full ring */
+		while(NULL != pipe_next_batch(stage))
+			pipe_release_batch(stage);
+	}
+	pthread_join(stage->thread, NULL);
+	free_stage(stage);
+}
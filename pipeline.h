@@ -0,0 +1,136 @@
+/**
+* @file pipeline.h
+* @brief Producer/consumer ingest pipeline. A parser thread turns the input
+*        stream into batches of ints while the caller builds the heap, and a
+*        writer thread prints values as sort_emit() extracts them, so parsing,
+*        heap construction and output overlap instead of running back to back.
+*
+*        Build: gcc -DPIPELINE -DNO_DEBUG heapsort.c heap_util.c pipeline.c -lpthread
+*/
+
+#ifndef _PIPELINE_H_
+#define _PIPELINE_H_
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include "heapsort.h"
+
+/** Number of values carried by one batch */
+#define PIPE_BATCH		(1024)
+
+/** Number of batches in a ring, has to be a power of 2 */
+#define PIPE_RING_SLOTS		(64)
+
+/** Input value that ends the stream, same as the interactive loop in main() */
+#define PIPE_END_MARKER		(-100)
+
+/** Keeps the producer and consumer indices on separate cache lines */
+#define PIPE_CACHE_LINE		(64)
+
+/** Polls of the other side's index before a waiting stage parks itself */
+#define PIPE_SPIN		(1024)
+
+/**
+	\brief struct pipe_batch: a fixed size block of values moved through the ring.
+	       A batch with count == 0 marks the end of the stream.
+*/
+typedef struct pipe_batch
+{
+	/** Number of valid entries in vals */
+	int count;
+	/** Values in stream order */
+	int vals[PIPE_BATCH];
+}pipe_batch;
+
+/**
+	\brief struct pipe_ring: bounded single-producer/single-consumer ring.
+	       Batches are filled in place, so nothing is copied or allocated
+	       once the ring exists.
+*/
+typedef struct pipe_ring
+{
+	/** Next slot the consumer reads, only written by the consumer */
+	_Atomic size_t head;
+	char pad0[PIPE_CACHE_LINE - sizeof(size_t)];
+	/** Next slot the producer fills, only written by the producer */
+	_Atomic size_t tail;
+	char pad1[PIPE_CACHE_LINE - sizeof(size_t)];
+	/** Stages parked on cond after spinning PIPE_SPIN times; the other
+	    side only takes lock when this is non-zero */
+	_Atomic int waiters;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	pipe_batch slot[PIPE_RING_SLOTS];
+}pipe_ring;
+
+/**
+	\brief struct pipe_stage: one ring plus the thread sitting on the other end of it
+*/
+typedef struct pipe_stage
+{
+	pipe_ring ring;
+	/** Parser or writer thread */
+	pthread_t thread;
+	/** Stream read by the parser or written by the writer */
+	FILE *fp;
+	/** Batch currently being filled by pipe_emit() (writer stage only) */
+	pipe_batch *cur;
+	/** TRUE for the writer stage, FALSE for the parser stage */
+	bool writer;
+	/** Set once the end of stream batch has been consumed */
+	bool done;
+}pipe_stage;
+
+/*!*******************************************************
+*	\fn pipe_start_parser(FILE *in)
+*	\brief - start a thread parsing whitespace separated ints from in,
+*		 until EOF or PIPE_END_MARKER
+*	\param in - input stream
+*	\return pipe_stage * - parser stage, NULL on failure
+*********************************************************/
+pipe_stage* pipe_start_parser(FILE *in);
+
+/*!*******************************************************
+*	\fn pipe_next_batch(pipe_stage *stage)
+*	\brief - wait for the next parsed batch. The batch stays valid until
+*		 pipe_release_batch() is called.
+*	\param stage - parser stage
+*	\return pipe_batch * - next batch, NULL once the input is exhausted
+*********************************************************/
+pipe_batch* pipe_next_batch(pipe_stage *stage);
+
+/*!*******************************************************
+*	\fn pipe_release_batch(pipe_stage *stage)
+*	\brief - hand the batch returned by pipe_next_batch() back to the parser
+*	\param stage - parser stage
+*	\return void
+*********************************************************/
+void pipe_release_batch(pipe_stage *stage);
+
+/*!*******************************************************
+*	\fn pipe_start_writer(FILE *out)
+*	\brief - start a thread printing every value passed to pipe_emit()
+*	\param out - output stream
+*	\return pipe_stage * - writer stage, NULL on failure
+*********************************************************/
+pipe_stage* pipe_start_writer(FILE *out);
+
+/*!*******************************************************
+*	\fn pipe_emit(int data, void *ctx)
+*	\brief - emit_fn for sort_emit(), queues data for the writer stage
+*	\param data - extracted value
+*	\param ctx - writer stage (pipe_stage *)
+*	\return void
+*********************************************************/
+void pipe_emit(int data, void *ctx);
+
+/*!*******************************************************
+*	\fn pipe_stop(pipe_stage *stage)
+*	\brief - flush (writer) or drain (parser) the stage, join its thread
+*		 and free it
+*	\param stage - parser or writer stage
+*	\return void
+*********************************************************/
+void pipe_stop(pipe_stage *stage);
+
+#endif // _PIPELINE_H_
@@ -0,0 +1,148 @@
+/**
+* @file record_sort.c
+* @brief Key/index record sort: heapsort the compact keys, move records once
+*/
+
+#include "record_sort.h"
+#include "heap_generic.h"
+
+/** Order on the key, ties broken on the input position so the sort is stable */
+#define REC_KEY_LT(a, b) \
+	(((a).key < (b).key) || (((a).key == (b).key) && ((a).idx < (b).idx)))
+
+GEN_HEAP(rkey, rec_key, REC_KEY_LT)
+
+/** Cache line size assumed for prefetching */
+#define REC_LINE		(64)
+
+/** Most lines of the next record prefetched while following a
+    permutation cycle (1 KB); larger records are fetched on demand past it */
+#define REC_PREFETCH_MAX_LINES	(16)
+
+/*!*******************************************************
+*	\fn record_sort_index(const void *recs, size_t n, size_t rec_size, size_t key_off, uint32_t *order)
+*	\brief - compute the sorted order of the records without moving them.
+*		 Records with equal keys keep their input order.
+*	\param recs - array of n records
+*	\param n - number of records, at most RECORD_SORT_MAX
+*	\param rec_size - size of one record in bytes
+*	\param key_off - offset of the uint64_t key inside a record
+*	\param order - out: order[i] is the input index of the i-th smallest record
+*	\return bool - FALSE if out of memory or n is too large
+*********************************************************/
+bool record_sort_index(const void *recs, size_t n, size_t rec_size, size_t key_off, uint32_t *order)
+{
+	const char *base = (const char*) recs;
+	rec_key *keys = NULL;
+	size_t i = 0;
+
+	/* Indices above 32 bits would alias */
+	if(n > RECORD_SORT_MAX)
+		return (FALSE);
+	if(0 == n)
+		return (TRUE);
+	keys = (rec_key*) malloc(n * sizeof(*keys));
+	if(NULL == keys)
+		return (FALSE);
+
+	/* One sequential pass over the records pulls out the keys,
+	   everything after this only touches the 16 byte pairs */
+	for(i = 0; i < n; i++)
+	{
+		memcpy(&keys[i].key, base + (i * rec_size) + key_off, sizeof(uint64_t));
+		keys[i].idx = (uint32_t) i;
+	}
+	rkey_heapsort(keys, n);
+
+	for(i = 0; i < n; i++)
+		order[i] = keys[i].idx;
+	free(keys);
+	return (TRUE);
+}
+
+/*!*******************************************************
+*	\fn record_permute(void *recs, size_t n, size_t rec_size, uint32_t *order)
+*	\brief - rearrange recs in place so that record order[i] ends up at i.
+*		 Follows the permutation cycles, so every record is copied
+*		 exactly once (plus one spare copy per cycle).
+*	\param recs - array of n records
+*	\param n - number of records
+*	\param rec_size - size of one record in bytes
+*	\param order - permutation from record_sort_index(), consumed (left as identity)
+*	\return bool - FALSE if out of memory
+*********************************************************/
+bool record_permute(void *recs, size_t n, size_t rec_size, uint32_t *order)
+{
+	char *base = (char*) recs;
+	char *tmp = (char*) malloc(rec_size);
+	size_t i = 0;
+	size_t j = 0;
+	size_t k = 0;
+	size_t line = 0;
+	/* Whole record, up to the cap */
+	size_t lines = (rec_size + REC_LINE - 1) / REC_LINE;
+	char *next = NULL;
+
+	if(NULL == tmp)
+		return (FALSE);
+	if(lines > REC_PREFETCH_MAX_LINES)
+		lines = REC_PREFETCH_MAX_LINES;
+
+	for(i = 0; i < n; i++)
+	{
+		/* Already in place, or already handled as part of an earlier cycle */
+		if(order[i] == i)
+			continue;
+
+		memcpy(tmp, base + (i * rec_size), rec_size);
+		j = i;
+		while(1)
+		{
+			k = order[j];
+			/* Mark slot j as done */
+			order[j] = (uint32_t) j;
+			if(k == i)
+			{
+				memcpy(base + (j * rec_size), tmp, rec_size);
+				break;
+			}
+			/* The next source record is a random jump away, start
+			   pulling it in while this one is copied */
+			next = base + (order[k] * rec_size);
+			for(line = 0; line < lines; line++)
+				__builtin_prefetch(next + (line * REC_LINE));
+			/* A record not starting on a line boundary spills into one more */
+			if(rec_size <= (REC_PREFETCH_MAX_LINES * REC_LINE))
+				__builtin_prefetch(next + rec_size - 1);
+			memcpy(base + (j * rec_size), base + (k * rec_size), rec_size);
+			j = k;
+		}
+	}
+	free(tmp);
+	return (TRUE);
+}
+
+/*!*******************************************************
+*	\fn record_sort(void *recs, size_t n, size_t rec_size, size_t key_off)
+*	\brief - sort the records in place by their uint64_t key, stable
+*	\param recs - array of n records
+*	\param n - number of records, at most RECORD_SORT_MAX
+*	\param rec_size - size of one record in bytes
+*	\param key_off - offset of the uint64_t key inside a record
+*	\return bool - FALSE if out of memory or n is too large
+*********************************************************/
+bool record_sort(void *recs, size_t n, size_t rec_size, size_t key_off)
+{
+	bool ok = FALSE;
+	uint32_t *order = NULL;
+
+	if(n > RECORD_SORT_MAX)
+		return (FALSE);
+	order = (uint32_t*) malloc((n ? n : 1) * sizeof(*order));
+	if(NULL == order)
+		return (FALSE);
+	if(TRUE == record_sort_index(recs, n, rec_size, key_off, order))
+		ok = record_permute(recs, n, rec_size, order);
+	free(order);
+	return (ok);
+}
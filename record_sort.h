@@ -0,0 +1,68 @@
+/**
+* @file record_sort.h
+* @brief Sorting of large fixed size records keyed on a 64 bit field.
+*        Only compact (key, index) pairs go through the heap; the records
+*        themselves are moved at most once, in a single permutation pass
+*        at the end, or not at all when only the order is asked for.
+*/
+
+#ifndef _RECORD_SORT_H_
+#define _RECORD_SORT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "heapsort.h"
+
+/** Largest input the sorts accept, the record index has 32 bits */
+#define RECORD_SORT_MAX		((size_t) UINT32_MAX + 1)
+
+/**
+	\brief struct rec_key: what the heap actually sorts, 16 bytes
+	       regardless of the record size
+*/
+typedef struct rec_key
+{
+	/** Copy of the record's 64 bit key */
+	uint64_t key;
+	/** Position of the record in the input array */
+	uint32_t idx;
+}rec_key;
+
+/*!*******************************************************
+*	\fn record_sort_index(const void *recs, size_t n, size_t rec_size, size_t key_off, uint32_t *order)
+*	\brief - compute the sorted order of the records without moving them.
+*		 Records with equal keys keep their input order.
+*	\param recs - array of n records
+*	\param n - number of records, at most RECORD_SORT_MAX
+*	\param rec_size - size of one record in bytes
+*	\param key_off - offset of the uint64_t key inside a record
+*	\param order - out: order[i] is the input index of the i-th smallest record
+*	\return bool - FALSE if out of memory or n is too large
+*********************************************************/
+bool record_sort_index(const void *recs, size_t n, size_t rec_size, size_t key_off, uint32_t *order);
+
+/*!*******************************************************
+*	\fn record_permute(void *recs, size_t n, size_t rec_size, uint32_t *order)
+*	\brief - rearrange recs in place so that record order[i] ends up at i.
+*		 Follows the permutation cycles, so every record is copied
+*		 exactly once (plus one spare copy per cycle).
+*	\param recs - array of n records
+*	\param n - number of records
+*	\param rec_size - size of one record in bytes
+*	\param order - permutation from record_sort_index(), consumed (left as identity)
+*	\return bool - FALSE if out of memory
+*********************************************************/
+bool record_permute(void *recs, size_t n, size_t rec_size, uint32_t *order);
+
+/*!*******************************************************
+*	\fn record_sort(void *recs, size_t n, size_t rec_size, size_t key_off)
+*	\brief - sort the records in place by their uint64_t key, stable
+*	\param recs - array of n records
+*	\param n - number of records, at most RECORD_SORT_MAX
+*	\param rec_size - size of one record in bytes
+*	\param key_off - offset of the uint64_t key inside a record
+*	\return bool - FALSE if out of memory or n is too large
+*********************************************************/
+bool record_sort(void *recs, size_t n, size_t rec_size, size_t key_off);
+
+#endif // _RECORD_SORT_H_
@@ -0,0 +1,497 @@
+/**
+* @file replay.c
+* @brief Trace replay driver. Plays a trace recorded by a -DTRACE build of
+*        llist.c or heapsort.c (see trace.h) against one engine, once flat
+*        out for throughput and once with every operation timed for the
+*        per operation latency percentiles.
+*
+*        Build: gcc -O2 -DHEAPSORT -DNO_DEBUG -DHEAPSORT_NO_MAIN -DLLIST_NO_MAIN \
+*                   -o replay replay.c trace.c heapsort.c heap_util.c llist.c \
+*                   bst_iter.c epoch.c lflist.c cbst.c -lpthread
+*        Usage: ./replay <trace> [list|heap|aheap|lflist|bst|cbst]
+*               ./replay -g <trace> [n]	(write a synthetic mixed trace)
+*
+*        Operations an engine has no equivalent for are skipped and
+*        reported per operation type: pops on the lists and trees, deletes
+*        on the heaps and trees (there is no BST or cbst delete), lookups
+*        on the heaps (no ordered search) and prints on everything but the
+*        list and the BST.
+*/
+
+#include <limits.h>
+#include <time.h>
+#include "heapsort.h"
+#include "heap_generic.h"
+#include "lflist.h"
+#include "cbst.h"
+#include "trace.h"
+
+GEN_HEAP(rint, int, KEY_LT)
+GEN_HEAP(lat, uint32_t, KEY_LT)
+
+/** Operations in a synthetic trace */
+#define REPLAY_GEN_DEFAULT	(200000)
+
+/** Key range of a synthetic trace, keeps the list engine's walks short */
+#define REPLAY_GEN_KEYS		(2048)
+
+/**
+	\brief struct replay_state: the structures every engine works on
+*/
+typedef struct replay_state
+{
+	/** list, heap and bst engines */
+	node *root;
+	/** aheap engine */
+	rint_heap heap;
+	/** lflist engine */
+	lflist list;
+	int tid;
+	/** cbst engine */
+	cbst tree;
+	int tree_tid;
+}replay_state;
+
+/** Sink for the silent print walks and lookup results, so the compiler
+    keeps the loops */
+static volatile int print_sink;
+
+/** Applies one record, FALSE if the engine has no such operation */
+typedef bool (*replay_fn) (replay_state *st, const trace_rec *r);
+
+/*!*******************************************************
+*	\fn now_ns
+*	\brief - monotonic clock in nanoseconds
+*	\return uint64_t - nanoseconds
+*********************************************************/
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec);
+}
+
+/*!*******************************************************
+*	\fn clock_overhead
+*	\brief - cost of the now_ns() pair around every timed operation
+*	\return uint64_t - smallest of a few hundred back to back readings
+*********************************************************/
+static uint64_t clock_overhead(void)
+{
+	uint64_t best = UINT64_MAX;
+	uint64_t t = 0;
+	int i = 0;
+
+	for(i = 0; i < 256; i++)
+	{
+		t = now_ns();
+		t = now_ns() - t;
+		if(t < best)
+			best = t;
+	}
+	return (best);
+}
+
+/*!*******************************************************
+*	\fn list_op(replay_state *st, const trace_rec *r)
+*	\brief - replay_fn for llist.c, the same calls its fn_arr makes
+*********************************************************/
+static bool list_op(replay_state *st, const trace_rec *r)
+{
+	node *iter = NULL;
+
+	switch(r->op)
+	{
+		case TRACE_INSERT:
+			insert_node(&st->root, r->arg, st->root);
+			return (TRUE);
+		case TRACE_APPEND:
+			append_link_node(&st->root, r->arg, NULL);
+			return (TRUE);
+		case TRACE_DELETE:
+			delete_node(&st->root, r->arg, st->root);
+			return (TRUE);
+		case TRACE_PRINT:
+			/* The walk print_nodes() does, without the terminal output */
+			for(iter = st->root; NULL != iter; iter = iter->link[NEXT])
+				print_sink = iter->data;
+			return (TRUE);
+		case TRACE_LOOKUP:
+			/* The list is descending, stop at the first smaller value */
+			for(iter = st->root; (NULL != iter) && (iter->data > r->arg); iter = iter->link[NEXT])
+				;
+			print_sink = ((NULL != iter) && (iter->data == r->arg));
+			return (TRUE);
+		default:
+			return (FALSE);
+	}
+}
+
+/*!*******************************************************
+*	\fn heap_op(replay_state *st, const trace_rec *r)
+*	\brief - replay_fn for the pointer heap (add_node() with HEAPSORT)
+*********************************************************/
+static bool heap_op(replay_state *st, const trace_rec *r)
+{
+	int data = 0;
+
+	switch(r->op)
+	{
+		case TRACE_INSERT:
+		case TRACE_PUSH:
+			add_node(&st->root, r->arg, st->root);
+			return (TRUE);
+		case TRACE_POP:
+			extract_min(&st->root, &data);
+			return (TRUE);
+		default:
+			return (FALSE);
+	}
+}
+
+/*!*******************************************************
+*	\fn aheap_op(replay_state *st, const trace_rec *r)
+*	\brief - replay_fn for the array heap from heap_generic.h
+*********************************************************/
+static bool aheap_op(replay_state *st, const trace_rec *r)
+{
+	int data = 0;
+
+	switch(r->op)
+	{
+		case TRACE_INSERT:
+		case TRACE_PUSH:
+			rint_heap_push(&st->heap, r->arg);
+			return (TRUE);
+		case TRACE_POP:
+			rint_heap_pop(&st->heap, &data);
+			return (TRUE);
+		default:
+			return (FALSE);
+	}
+}
+
+/*!*******************************************************
+*	\fn lflist_op(replay_state *st, const trace_rec *r)
+*	\brief - replay_fn for the lock-free list, single threaded
+*********************************************************/
+static bool lflist_op(replay_state *st, const trace_rec *r)
+{
+	switch(r->op)
+	{
+		case TRACE_INSERT:
+		case TRACE_APPEND:
+			/* Sorted list: an append lands wherever its value belongs */
+			lflist_insert(&st->list, st->tid, r->arg);
+			return (TRUE);
+		case TRACE_DELETE:
+			lflist_delete(&st->list, st->tid, r->arg);
+			return (TRUE);
+		case TRACE_LOOKUP:
+			print_sink = lflist_find(&st->list, st->tid, r->arg);
+			return (TRUE);
+		default:
+			return (FALSE);
+	}
+}
+
+/*!*******************************************************
+*	\fn bst_insert(node **root, int data)
+*	\brief - plain BST insert; add_node() is built with HEAPSORT here
+*	\param root - tree root
+*	\param data - new value
+*	\return void
+*********************************************************/
+static void bst_insert(node **root, int data)
+{
+	node *parent = NULL;
+	while(NULL != *root)
+	{
+		parent = *root;
+		parent->size++;
+		root = &parent->link[DIR(data, parent->data)];
+	}
+	*root = create_node(data, parent);
+}
+
+/*!*******************************************************
+*	\fn print_walk(int data, void *ctx)
+*	\brief - emit_fn for the BST print, nothing reaches the terminal
+*********************************************************/
+static void print_walk(int data, void *ctx)
+{
+	(void) ctx;
+	print_sink = data;
+}
+
+/*!*******************************************************
+*	\fn bst_op(replay_state *st, const trace_rec *r)
+*	\brief - replay_fn for the binary search tree: bst_insert(),
+*		 find_node() and an in-order walk for print
+*********************************************************/
+static bool bst_op(replay_state *st, const trace_rec *r)
+{
+	switch(r->op)
+	{
+		case TRACE_INSERT:
+		case TRACE_APPEND:
+		case TRACE_PUSH:
+			bst_insert(&st->root, r->arg);
+			return (TRUE);
+		case TRACE_LOOKUP:
+			print_sink = (NULL != find_node(st->root, r->arg));
+			return (TRUE);
+		case TRACE_PRINT:
+			bst_range_scan(st->root, INT_MIN, INT_MAX, print_walk, NULL);
+			return (TRUE);
+		default:
+			return (FALSE);
+	}
+}
+
+/*!*******************************************************
+*	\fn cbst_op(replay_state *st, const trace_rec *r)
+*	\brief - replay_fn for the concurrent BST, single threaded
+*********************************************************/
+static bool cbst_op(replay_state *st, const trace_rec *r)
+{
+	switch(r->op)
+	{
+		case TRACE_INSERT:
+		case TRACE_APPEND:
+		case TRACE_PUSH:
+			cbst_insert(&st->tree, st->tree_tid, r->arg);
+			return (TRUE);
+		case TRACE_LOOKUP:
+			print_sink = cbst_find(&st->tree, st->tree_tid, r->arg);
+			return (TRUE);
+		default:
+			return (FALSE);
+	}
+}
+
+/*!*******************************************************
+*	\fn state_init(replay_state *st)
+*	\brief - empty structures for one replay pass
+*	\param st - state
+*	\return bool - FALSE if out of memory
+*********************************************************/
+static bool state_init(replay_state *st)
+{
+	memset(st, 0, sizeof(*st));
+	if(FALSE == lflist_init(&st->list, 1))
+		return (FALSE);
+	st->tid = lflist_register(&st->list);
+	if(FALSE == cbst_init(&st->tree, 1))
+	{
+		lflist_free(&st->list);
+		return (FALSE);
+	}
+	st->tree_tid = cbst_register(&st->tree);
+	return (TRUE);
+}
+
+/*!*******************************************************
+*	\fn state_free(replay_state *st, replay_fn fn)
+*	\brief - free whatever the pass left behind
+*	\param st - state
+*	\param fn - engine the pass ran
+*	\return void
+*********************************************************/
+static void state_free(replay_state *st, replay_fn fn)
+{
+	if(list_op == fn)
+		free_link_nodes(&st->root, 0, NULL);
+	else
+		free_tree(st->root);
+	st->root = NULL;
+	rint_heap_free(&st->heap);
+	lflist_free(&st->list);
+	cbst_free(&st->tree);
+}
+
+/*!*******************************************************
+*	\fn generate(const char *path, size_t n)
+*	\brief - write a synthetic trace: 30% insert, 20% delete, 30% lookup,
+*		 10% push, 10% pop over REPLAY_GEN_KEYS keys
+*	\param path - trace file
+*	\param n - number of operations
+*	\return int - exit status
+*********************************************************/
+static int generate(const char *path, size_t n)
+{
+	trace_writer *tw = trace_open(path);
+	unsigned int r = 0;
+	size_t i = 0;
+	trace_op op = TRACE_INSERT;
+
+	if(NULL == tw)
+	{
+		printf("can't create %s\n", path);
+		return 1;
+	}
+	for(i = 0; i < n; i++)
+	{
+		r = (unsigned int) rand();
+		switch(r % 10)
+		{
+			case 0: case 1: case 2:	op = TRACE_INSERT; break;
+			case 3: case 4:		op = TRACE_DELETE; break;
+			case 5: case 6: case 7:	op = TRACE_LOOKUP; break;
+			case 8:			op = TRACE_PUSH; break;
+			default:		op = TRACE_POP; break;
+		}
+		trace_record(tw, op, (int)((r / 10) % REPLAY_GEN_KEYS));
+	}
+	if(FALSE == trace_close(tw))
+	{
+		printf("write to %s failed\n", path);
+		return 1;
+	}
+	printf("wrote %zu operations to %s\n", n, path);
+	return 0;
+}
+
+/*!*******************************************************
+*	\fn percentile(const uint32_t *sorted, size_t n, double p)
+*	\brief - nearest rank percentile
+*	\param sorted - ascending samples
+*	\param n - number of samples, > 0
+*	\param p - percentile, 0..100
+*	\return uint32_t - sample at p
+*********************************************************/
+static uint32_t percentile(const uint32_t *sorted, size_t n, double p)
+{
+	size_t k = (size_t)((p / 100.0) * (double)(n - 1) + 0.5);
+	return (sorted[k]);
+}
+
+/*!*******************************************************
+*	\fn replay(const trace_rec *recs, size_t n, const char *engine, replay_fn fn)
+*	\brief - run the trace flat out, then again timing each operation,
+*		 and print the results
+*	\param recs - trace
+*	\param n - number of records
+*	\param engine - engine name for the report
+*	\param fn - engine
+*	\return void
+*********************************************************/
+static void replay(const trace_rec *recs, size_t n, const char *engine, replay_fn fn)
+{
+	uint32_t *lat[TRACE_OP_COUNT];
+	size_t cnt[TRACE_OP_COUNT];
+	size_t skip[TRACE_OP_COUNT];
+	size_t skipped = 0;
+	replay_state st;
+	uint64_t t = 0;
+	uint64_t t0 = 0;
+	size_t i = 0;
+	int op = 0;
+
+	/* Pass 1: throughput, no clock reads inside the loop */
+	if(FALSE == state_init(&st))
+		return;
+	memset(skip, 0, sizeof(skip));
+	t = now_ns();
+	for(i = 0; i < n; i++)
+	{
+		if(FALSE == fn(&st, &recs[i]))
+			skip[recs[i].op]++;
+	}
+	t = now_ns() - t;
+	state_free(&st, fn);
+	for(op = 0; op < TRACE_OP_COUNT; op++)
+		skipped += skip[op];
+	printf("%-8s %10zu ops %10.3f Mops/s (%zu skipped)\n", engine, n - skipped,
+	       (t > 0) ? ((double)(n - skipped) / (double) t) * 1e3 : 0.0, skipped);
+	for(op = TRACE_INSERT; op < TRACE_OP_COUNT; op++)
+	{
+		if(0 != skip[op])
+			printf("  %-8s %10zu skipped, not supported by %s\n", trace_op_name[op], skip[op], engine);
+	}
+
+	/* Pass 2: latency of every operation, grouped by type */
+	memset(cnt, 0, sizeof(cnt));
+	for(i = 0; i < n; i++)
+		cnt[recs[i].op]++;
+	for(op = 0; op < TRACE_OP_COUNT; op++)
+	{
+		lat[op] = (uint32_t*) malloc((cnt[op] + 1) * sizeof(uint32_t));
+		cnt[op] = 0;
+	}
+	if(FALSE == state_init(&st))
+		goto out;
+	for(i = 0; i < n; i++)
+	{
+		op = (int) recs[i].op;
+		t0 = now_ns();
+		if(FALSE == fn(&st, &recs[i]))
+			continue;
+		t = now_ns() - t0;
+		if(NULL != lat[op])
+			lat[op][cnt[op]++] = (t > UINT32_MAX) ? UINT32_MAX : (uint32_t) t;
+	}
+	state_free(&st, fn);
+
+	printf("  %-8s %10s %8s %8s %8s %8s %10s  (ns, incl. ~%u ns clock overhead)\n",
+	       "op", "count", "p50", "p90", "p99", "p99.9", "max", (unsigned int) clock_overhead());
+	for(op = TRACE_INSERT; op < TRACE_OP_COUNT; op++)
+	{
+		if((NULL == lat[op]) || (0 == cnt[op]))
+			continue;
+		lat_heapsort(lat[op], cnt[op]);
+		printf("  %-8s %10zu %8u %8u %8u %8u %10u\n", trace_op_name[op], cnt[op],
+		       percentile(lat[op], cnt[op], 50), percentile(lat[op], cnt[op], 90),
+		       percentile(lat[op], cnt[op], 99), percentile(lat[op], cnt[op], 99.9),
+		       lat[op][cnt[op] - 1]);
+	}
+
+out:
+	for(op = 0; op < TRACE_OP_COUNT; op++)
+		free(lat[op]);
+}
+
+/*!*************************************************************************
+	\fn main
+	\brief - replay a trace, or generate one with -g
+****************************************************************************/
+int main(int argc, char **argv)
+{
+	static const char *names[] = {"list", "heap", "aheap", "lflist", "bst", "cbst"};
+	static const replay_fn fns[] = {list_op, heap_op, aheap_op, lflist_op, bst_op, cbst_op};
+	const char *which = (argc > 2) ? argv[2] : NULL;
+	trace_rec *recs = NULL;
+	size_t n = 0;
+	size_t e = 0;
+	bool ran = FALSE;
+
+	if((argc > 2) && (0 == strcmp(argv[1], "-g")))
+		return (generate(argv[2], (argc > 3) ? strtoul(argv[3], NULL, 0) : REPLAY_GEN_DEFAULT));
+	if(argc < 2)
+	{
+		printf("usage: %s <trace> [list|heap|aheap|lflist|bst|cbst]\n"
+		       "       %s -g <trace> [n]\n", argv[0], argv[0]);
+		return 1;
+	}
+
+	recs = trace_load(argv[1], &n);
+	if(NULL == recs)
+	{
+		printf("%s is not a readable trace\n", argv[1]);
+		return 1;
+	}
+	for(e = 0; e < sizeof(names) / sizeof(names[0]); e++)
+	{
+		if((NULL != which) && (0 != strcmp(which, names[e])))
+			continue;
+		replay(recs, n, names[e], fns[e]);
+		ran = TRUE;
+	}
+	free(recs);
+	if(FALSE == ran)
+	{
+		printf("unknown engine %s\n", which);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,574 @@
+/**
+* @file simd_sort.c
+* @brief AVX2 / SSE4.1 / scalar sorting networks and merge kernels
+*/
+
+#include <limits.h>
+#include "simd_sort.h"
+#include "hugemem.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+ #include <immintrin.h>
+ #define SIMD_X86
+ #define AVX2_FN	__attribute__((target("avx2")))
+ #define SSE41_FN	__attribute__((target("sse4.1")))
+#endif /* x86 */
+
+/** Values sorted by insertion before the scalar kernel starts merging */
+#define SCALAR_BLOCK	(16)
+
+const char *simd_isa_name[SIMD_ISA_COUNT] = {"scalar", "sse4.1", "avx2"};
+
+/** Merges two runs, see simd_merge() */
+typedef void (*merge_fn) (const int *a, size_t na, const int *b, size_t nb, int *out);
+
+/** Sorts m values in place into runs of the returned length. m is a
+    multiple of the kernel's block and the tail is padded with INT_MAX. */
+typedef size_t (*block_fn) (int *a, size_t m);
+
+/**
+	\brief struct simd_kernel: one instruction set's building blocks
+*/
+typedef struct simd_kernel
+{
+	/** Values per block_fn block */
+	size_t block;
+	block_fn sort_blocks;
+	merge_fn merge;
+}simd_kernel;
+
+/*!*******************************************************
+*	\fn merge_tail(const int *a, size_t na, const int *b, size_t nb,
+*		       const int *c, size_t nc, int *out)
+*	\brief - three way scalar merge, finishes what a vector merge left.
+*		 Ties go to the earlier run.
+*	\return void
+*********************************************************/
+static void merge_tail(const int *a, size_t na, const int *b, size_t nb,
+		       const int *c, size_t nc, int *out)
+{
+	size_t ia = 0;
+	size_t ib = 0;
+	size_t ic = 0;
+
+	while((ia < na) || (ib < nb) || (ic < nc))
+	{
+		if((ia < na) && ((ib >= nb) || (a[ia] <= b[ib])) && ((ic >= nc) || (a[ia] <= c[ic])))
+			*out++ = a[ia++];
+		else if((ib < nb) && ((ic >= nc) || (b[ib] <= c[ic])))
+			*out++ = b[ib++];
+		else
+			*out++ = c[ic++];
+	}
+}
+
+/*!*******************************************************
+*	\fn scalar_merge(const int *a, size_t na, const int *b, size_t nb, int *out)
+*	\brief - merge_fn in plain C, the selects compile to cmov
+*	\return void
+*********************************************************/
+static void scalar_merge(const int *a, size_t na, const int *b, size_t nb, int *out)
+{
+	size_t ia = 0;
+	size_t ib = 0;
+	int take_a = 0;
+
+	while((ia < na) && (ib < nb))
+	{
+		take_a = (a[ia] <= b[ib]);
+		*out++ = take_a ? a[ia] : b[ib];
+		ia += take_a;
+		ib += !take_a;
+	}
+	merge_tail(a + ia, na - ia, b + ib, nb - ib, NULL, 0, out);
+}
+
+/*!*******************************************************
+*	\fn scalar_blocks(int *a, size_t m)
+*	\brief - block_fn in plain C: insertion sort of SCALAR_BLOCK slices
+*	\return size_t - SCALAR_BLOCK
+*********************************************************/
+static size_t scalar_blocks(int *a, size_t m)
+{
+	size_t b = 0;
+	size_t i = 0;
+	size_t j = 0;
+	int v = 0;
+
+	for(b = 0; b < m; b += SCALAR_BLOCK)
+	{
+		for(i = b + 1; i < b + SCALAR_BLOCK; i++)
+		{
+			v = a[i];
+			for(j = i; (j > b) && (a[j - 1] > v); j--)
+				a[j] = a[j - 1];
+			a[j] = v;
+		}
+	}
+	return (SCALAR_BLOCK);
+}
+
+#ifdef SIMD_X86
+/* ---------------------------------------------------------------- SSE4.1 */
+
+/** Compare-exchange of two registers, lane by lane */
+#define SSE_CX(x, y) \
+	do { __m128i _t = _mm_min_epi32(x, y); y = _mm_max_epi32(x, y); x = _t; } while(0)
+
+/*!*******************************************************
+*	\fn sse_bitonic4(__m128i v)
+*	\brief - sort a bitonic sequence of 4 (half cleaner, then pairs)
+*	\return __m128i - ascending
+*********************************************************/
+SSE41_FN static inline __m128i sse_bitonic4(__m128i v)
+{
+	__m128i p = _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+	v = _mm_blend_epi16(_mm_min_epi32(v, p), _mm_max_epi32(v, p), 0xF0);
+	p = _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1));
+	v = _mm_blend_epi16(_mm_min_epi32(v, p), _mm_max_epi32(v, p), 0xCC);
+	return (v);
+}
+
+/*!*******************************************************
+*	\fn sse_merge8(__m128i *lo, __m128i *hi)
+*	\brief - merge two ascending registers: *lo gets the smallest 4,
+*		 *hi the largest 4, both ascending
+*	\return void
+*********************************************************/
+SSE41_FN static inline void sse_merge8(__m128i *lo, __m128i *hi)
+{
+	/* Ascending against descending gives two bitonic halves, every value
+	   of the min half below every value of the max half */
+	__m128i r = _mm_shuffle_epi32(*hi, _MM_SHUFFLE(0, 1, 2, 3));
+	__m128i mn = _mm_min_epi32(*lo, r);
+	__m128i mx = _mm_max_epi32(*lo, r);
+	*lo = sse_bitonic4(mn);
+	*hi = sse_bitonic4(mx);
+}
+
+/*!*******************************************************
+*	\fn sse_blocks(int *a, size_t m)
+*	\brief - block_fn: 4x4 column network, transpose, then one merge
+*		 step per block
+*	\return size_t - 8
+*********************************************************/
+SSE41_FN static size_t sse_blocks(int *a, size_t m)
+{
+	__m128i r0, r1, r2, r3, t0, t1, t2, t3;
+	size_t b = 0;
+
+	for(b = 0; b < m; b += 16)
+	{
+		r0 = _mm_loadu_si128((const __m128i*)(a + b));
+		r1 = _mm_loadu_si128((const __m128i*)(a + b + 4));
+		r2 = _mm_loadu_si128((const __m128i*)(a + b + 8));
+		r3 = _mm_loadu_si128((const __m128i*)(a + b + 12));
+
+		/* Optimal 4 input network on each column */
+		SSE_CX(r0, r1); SSE_CX(r2, r3);
+		SSE_CX(r0, r2); SSE_CX(r1, r3);
+		SSE_CX(r1, r2);
+
+		/* Columns become rows */
+		t0 = _mm_unpacklo_epi32(r0, r1);
+		t1 = _mm_unpackhi_epi32(r0, r1);
+		t2 = _mm_unpacklo_epi32(r2, r3);
+		t3 = _mm_unpackhi_epi32(r2, r3);
+		r0 = _mm_unpacklo_epi64(t0, t2);
+		r1 = _mm_unpackhi_epi64(t0, t2);
+		r2 = _mm_unpacklo_epi64(t1, t3);
+		r3 = _mm_unpackhi_epi64(t1, t3);
+
+		sse_merge8(&r0, &r1);
+		sse_merge8(&r2, &r3);
+		_mm_storeu_si128((__m128i*)(a + b), r0);
+		_mm_storeu_si128((__m128i*)(a + b + 4), r1);
+		_mm_storeu_si128((__m128i*)(a + b + 8), r2);
+		_mm_storeu_si128((__m128i*)(a + b + 12), r3);
+	}
+	return (8);
+}
+
+/*!*******************************************************
+*	\fn sse_merge(const int *a, size_t na, const int *b, size_t nb, int *out)
+*	\brief - merge_fn: 4 values out per sse_merge8() step
+*	\return void
+*********************************************************/
+SSE41_FN static void sse_merge(const int *a, size_t na, const int *b, size_t nb, int *out)
+{
+	size_t ia = 4;
+	size_t ib = 4;
+	__m128i lo, hi;
+	int pend[4];
+
+	if((na < 4) || (nb < 4))
+	{
+		scalar_merge(a, na, b, nb, out);
+		return;
+	}
+	lo = _mm_loadu_si128((const __m128i*) a);
+	hi = _mm_loadu_si128((const __m128i*) b);
+	while(1)
+	{
+		sse_merge8(&lo, &hi);
+		_mm_storeu_si128((__m128i*) out, lo);
+		out += 4;
+		/* Refill from the run with the smaller head; a run with fewer
+		   than 4 left ends the vector loop unless it is empty */
+		if((ia + 4 <= na) && ((ib + 4 > nb) ? (ib == nb) : (a[ia] <= b[ib])))
+		{
+			lo = _mm_loadu_si128((const __m128i*)(a + ia));
+			ia += 4;
+		}
+		else if((ib + 4 <= nb) && ((ia + 4 > na) ? (ia == na) : TRUE))
+		{
+			lo = _mm_loadu_si128((const __m128i*)(b + ib));
+			ib += 4;
+		}
+		else
+			break;
+	}
+	_mm_storeu_si128((__m128i*) pend, hi);
+	merge_tail(pend, 4, a + ia, na - ia, b + ib, nb - ib, out);
+}
+
+/* ------------------------------------------------------------------ AVX2 */
+
+/** Compare-exchange of two registers, lane by lane */
+#define AVX_CX(x, y) \
+	do { __m256i _t = _mm256_min_epi32(x, y); y = _mm256_max_epi32(x, y); x = _t; } while(0)
+
+/*!*******************************************************
+*	\fn avx_bitonic8(__m256i v)
+*	\brief - sort a bitonic sequence of 8: distance 4, 2, 1
+*	\return __m256i - ascending
+*********************************************************/
+AVX2_FN static inline __m256i avx_bitonic8(__m256i v)
+{
+	__m256i p = _mm256_permute2x128_si256(v, v, 0x01);
+	v = _mm256_blend_epi32(_mm256_min_epi32(v, p), _mm256_max_epi32(v, p), 0xF0);
+	p = _mm256_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+	v = _mm256_blend_epi32(_mm256_min_epi32(v, p), _mm256_max_epi32(v, p), 0xCC);
+	p = _mm256_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1));
+	v = _mm256_blend_epi32(_mm256_min_epi32(v, p), _mm256_max_epi32(v, p), 0xAA);
+	return (v);
+}
+
+/*!*******************************************************
+*	\fn avx_merge16(__m256i *lo, __m256i *hi)
+*	\brief - merge two ascending registers: *lo gets the smallest 8,
+*		 *hi the largest 8, both ascending
+*	\return void
+*********************************************************/
+AVX2_FN static inline void avx_merge16(__m256i *lo, __m256i *hi)
+{
+	__m256i r = _mm256_permutevar8x32_epi32(*hi, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+	__m256i mn = _mm256_min_epi32(*lo, r);
+	__m256i mx = _mm256_max_epi32(*lo, r);
+	*lo = avx_bitonic8(mn);
+	*hi = avx_bitonic8(mx);
+}
+
+/*!*******************************************************
+*	\fn avx_blocks(int *a, size_t m)
+*	\brief - block_fn: 8x8 column network (19 compare-exchanges),
+*		 transpose, then one merge step per block
+*	\return size_t - 16
+*********************************************************/
+AVX2_FN static size_t avx_blocks(int *a, size_t m)
+{
+	__m256i r0, r1, r2, r3, r4, r5, r6, r7;
+	__m256i t0, t1, t2, t3, t4, t5, t6, t7;
+	size_t b = 0;
+
+	for(b = 0; b < m; b += 64)
+	{
+		r0 = _mm256_loadu_si256((const __m256i*)(a + b));
+		r1 = _mm256_loadu_si256((const __m256i*)(a + b + 8));
+		r2 = _mm256_loadu_si256((const __m256i*)(a + b + 16));
+		r3 = _mm256_loadu_si256((const __m256i*)(a + b + 24));
+		r4 = _mm256_loadu_si256((const __m256i*)(a + b + 32));
+		r5 = _mm256_loadu_si256((const __m256i*)(a + b + 40));
+		r6 = _mm256_loadu_si256((const __m256i*)(a + b + 48));
+		r7 = _mm256_loadu_si256((const __m256i*)(a + b + 56));
+
+		/* Optimal 8 input network on each column */
+		AVX_CX(r0, r2); AVX_CX(r1, r3); AVX_CX(r4, r6); AVX_CX(r5, r7);
+		AVX_CX(r0, r4); AVX_CX(r1, r5); AVX_CX(r2, r6); AVX_CX(r3, r7);
+		AVX_CX(r0, r1); AVX_CX(r2, r3); AVX_CX(r4, r5); AVX_CX(r6, r7);
+		AVX_CX(r2, r4); AVX_CX(r3, r5);
+		AVX_CX(r1, r4); AVX_CX(r3, r6);
+		AVX_CX(r1, r2); AVX_CX(r3, r4); AVX_CX(r5, r6);
+
+		/* Columns become rows */
+		t0 = _mm256_unpacklo_epi32(r0, r1);
+		t1 = _mm256_unpackhi_epi32(r0, r1);
+		t2 = _mm256_unpacklo_epi32(r2, r3);
+		t3 = _mm256_unpackhi_epi32(r2, r3);
+		t4 = _mm256_unpacklo_epi32(r4, r5);
+		t5 = _mm256_unpackhi_epi32(r4, r5);
+		t6 = _mm256_unpacklo_epi32(r6, r7);
+		t7 = _mm256_unpackhi_epi32(r6, r7);
+		r0 = _mm256_unpacklo_epi64(t0, t2);
+		r1 = _mm256_unpackhi_epi64(t0, t2);
+		r2 = _mm256_unpacklo_epi64(t1, t3);
+		r3 = _mm256_unpackhi_epi64(t1, t3);
+		r4 = _mm256_unpacklo_epi64(t4, t6);
+		r5 = _mm256_unpackhi_epi64(t4, t6);
+		r6 = _mm256_unpacklo_epi64(t5, t7);
+		r7 = _mm256_unpackhi_epi64(t5, t7);
+		t0 = _mm256_permute2x128_si256(r0, r4, 0x20);
+		t1 = _mm256_permute2x128_si256(r1, r5, 0x20);
+		t2 = _mm256_permute2x128_si256(r2, r6, 0x20);
+		t3 = _mm256_permute2x128_si256(r3, r7, 0x20);
+		t4 = _mm256_permute2x128_si256(r0, r4, 0x31);
+		t5 = _mm256_permute2x128_si256(r1, r5, 0x31);
+		t6 = _mm256_permute2x128_si256(r2, r6, 0x31);
+		t7 = _mm256_permute2x128_si256(r3, r7, 0x31);
+
+		avx_merge16(&t0, &t1);
+		avx_merge16(&t2, &t3);
+		avx_merge16(&t4, &t5);
+		avx_merge16(&t6, &t7);
+		_mm256_storeu_si256((__m256i*)(a + b), t0);
+		_mm256_storeu_si256((__m256i*)(a + b + 8), t1);
+		_mm256_storeu_si256((__m256i*)(a + b + 16), t2);
+		_mm256_storeu_si256((__m256i*)(a + b + 24), t3);
+		_mm256_storeu_si256((__m256i*)(a + b + 32), t4);
+		_mm256_storeu_si256((__m256i*)(a + b + 40), t5);
+		_mm256_storeu_si256((__m256i*)(a + b + 48), t6);
+		_mm256_storeu_si256((__m256i*)(a + b + 56), t7);
+	}
+	return (16);
+}
+
+/*!*******************************************************
+*	\fn avx_merge(const int *a, size_t na, const int *b, size_t nb, int *out)
+*	\brief - merge_fn: 8 values out per avx_merge16() step
+*	\return void
+*********************************************************/
+AVX2_FN static void avx_merge(const int *a, size_t na, const int *b, size_t nb, int *out)
+{
+	size_t ia = 8;
+	size_t ib = 8;
+	__m256i lo, hi;
+	int pend[8];
+
+	if((na < 8) || (nb < 8))
+	{
+		scalar_merge(a, na, b, nb, out);
+		return;
+	}
+	lo = _mm256_loadu_si256((const __m256i*) a);
+	hi = _mm256_loadu_si256((const __m256i*) b);
+	while(1)
+	{
+		avx_merge16(&lo, &hi);
+		_mm256_storeu_si256((__m256i*) out, lo);
+		out += 8;
+		/* Refill from the run with the smaller head; a run with fewer
+		   than 8 left ends the vector loop unless it is empty */
+		if((ia + 8 <= na) && ((ib + 8 > nb) ? (ib == nb) : (a[ia] <= b[ib])))
+		{
+			lo = _mm256_loadu_si256((const __m256i*)(a + ia));
+			ia += 8;
+		}
+		else if((ib + 8 <= nb) && ((ia + 8 > na) ? (ia == na) : TRUE))
+		{
+			lo = _mm256_loadu_si256((const __m256i*)(b + ib));
+			ib += 8;
+		}
+		else
+			break;
+	}
+	_mm256_storeu_si256((__m256i*) pend, hi);
+	merge_tail(pend, 8, a + ia, na - ia, b + ib, nb - ib, out);
+}
+#endif /* SIMD_X86 */
+
+/** Kernels by simd_isa; entries the build can't provide stay scalar */
+static const simd_kernel kernels[SIMD_ISA_COUNT] =
+{
+	{SCALAR_BLOCK, scalar_blocks, scalar_merge},
+#ifdef SIMD_X86
+	{16, sse_blocks, sse_merge},
+	{64, avx_blocks, avx_merge}
+#else
+	{SCALAR_BLOCK, scalar_blocks, scalar_merge},
+	{SCALAR_BLOCK, scalar_blocks, scalar_merge}
+#endif /* SIMD_X86 */
+};
+
+/** Kernel in use, set before main() runs */
+static simd_isa cur_isa = SIMD_SCALAR;
+
+/*!*******************************************************
+*	\fn isa_supported(simd_isa isa)
+*	\brief - can this CPU run isa
+*	\return bool - TRUE if it can
+*********************************************************/
+static bool isa_supported(simd_isa isa)
+{
+	switch(isa)
+	{
+		case SIMD_SCALAR:
+			return (TRUE);
+#ifdef SIMD_X86
+		case SIMD_SSE41:
+			return (__builtin_cpu_supports("sse4.1") ? TRUE : FALSE);
+		case SIMD_AVX2:
+			return (__builtin_cpu_supports("avx2") ? TRUE : FALSE);
+#endif /* SIMD_X86 */
+		default:
+			return (FALSE);
+	}
+}
+
+/*!*******************************************************
+*	\fn simd_sort_init(void)
+*	\brief - pick the best kernel the CPU supports, runs before main()
+*	\return void
+*********************************************************/
+__attribute__((constructor)) static void simd_sort_init(void)
+{
+	int isa = SIMD_ISA_COUNT;
+
+#ifdef SIMD_X86
+	__builtin_cpu_init();
+#endif /* SIMD_X86 */
+	while(--isa > SIMD_SCALAR)
+	{
+		if(TRUE == isa_supported((simd_isa) isa))
+			break;
+	}
+	cur_isa = (simd_isa) isa;
+}
+
+/*!*******************************************************
+*	\fn simd_sort_isa(void)
+*	\brief - kernel in use
+*	\return simd_isa - SIMD_SCALAR, SIMD_SSE41 or SIMD_AVX2
+*********************************************************/
+simd_isa simd_sort_isa(void)
+{
+	return (cur_isa);
+}
+
+/*!*******************************************************
+*	\fn simd_sort_set_isa(simd_isa isa)
+*	\brief - switch kernels, for benchmarks and tests. Not thread safe.
+*	\param isa - kernel to use
+*	\return bool - FALSE if this CPU can't run it (nothing changes then)
+*********************************************************/
+bool simd_sort_set_isa(simd_isa isa)
+{
+	if((isa >= SIMD_ISA_COUNT) || (FALSE == isa_supported(isa)))
+		return (FALSE);
+	cur_isa = isa;
+	return (TRUE);
+}
+
+/*!*******************************************************
+*	\fn simd_merge(const int *a, size_t na, const int *b, size_t nb, int *out)
+*	\brief - merge two ascending runs
+*	\param a - first run
+*	\param na - length of a
+*	\param b - second run
+*	\param nb - length of b
+*	\param out - na + nb slots, must not overlap a or b
+*	\return void
+*********************************************************/
+void simd_merge(const int *a, size_t na, const int *b, size_t nb, int *out)
+{
+	kernels[cur_isa].merge(a, na, b, nb, out);
+}
+
+/*!*******************************************************
+*	\fn merge_passes(int *src, int *dst, size_t n, size_t run, merge_fn merge)
+*	\brief - bottom-up merge of the runs of length run in src,
+*		 ping-ponging between the two buffers
+*	\param src - n values in runs of length run (the last may be shorter)
+*	\param dst - n slots of scratch
+*	\param n - number of values
+*	\param run - initial run length
+*	\param merge - kernel
+*	\return int * - src or dst, whichever holds the sorted result
+*********************************************************/
+static int* merge_passes(int *src, int *dst, size_t n, size_t run, merge_fn merge)
+{
+	size_t i = 0;
+	size_t mid = 0;
+	size_t end = 0;
+	int *t = NULL;
+
+	for(; run < n; run *= 2)
+	{
+		for(i = 0; i < n; i += 2 * run)
+		{
+			mid = ((i + run) < n) ? (i + run) : n;
+			end = ((i + (2 * run)) < n) ? (i + (2 * run)) : n;
+			if(mid == end)
+				memcpy(dst + i, src + i, (end - i) * sizeof(*src));
+			else
+				merge(src + i, mid - i, src + mid, end - mid, dst + i);
+		}
+		t = src;
+		src = dst;
+		dst = t;
+	}
+	return (src);
+}
+
+/*!*******************************************************
+*	\fn simd_sort(int *a, size_t n)
+*	\brief - sort a[] ascending. Inputs up to SIMD_SORT_MAX use two stack
+*		 buffers; larger ones are sorted in SIMD_SORT_MAX blocks and
+*		 merged through one heap buffer.
+*	\param a - array to sort
+*	\param n - number of elements
+*	\return bool - FALSE if out of memory (only for n > SIMD_SORT_MAX,
+*		 a[] is then left unsorted)
+*********************************************************/
+bool simd_sort(int *a, size_t n)
+{
+	const simd_kernel *k = &kernels[cur_isa];
+	int buf[2][SIMD_SORT_MAX];
+	int *res = NULL;
+	int *tmp = NULL;
+	size_t m = 0;
+	size_t i = 0;
+	size_t run = 0;
+
+	if(n < 2)
+		return (TRUE);
+
+	if(n > SIMD_SORT_MAX)
+	{
+		tmp = (int*) huge_alloc(n * sizeof(*tmp));
+		if(NULL == tmp)
+			return (FALSE);
+		for(i = 0; i < n; i += SIMD_SORT_MAX)
+			simd_sort(a + i, ((n - i) < SIMD_SORT_MAX) ? (n - i) : SIMD_SORT_MAX);
+		res = merge_passes(a, tmp, n, SIMD_SORT_MAX, k->merge);
+		if(res != a)
+			memcpy(a, res, n * sizeof(*a));
+		huge_free(tmp, n * sizeof(*tmp));
+		return (TRUE);
+	}
+
+	/* Padding 32 values or fewer out to a 64 value AVX2 block costs more
+	   than the wider registers save; AVX2 CPUs all have SSE4.1 */
+	if((SIMD_AVX2 == cur_isa) && (n <= 32))
+		k = &kernels[SIMD_SSE41];
+
+	/* Round up to whole blocks; INT_MAX padding sorts to the back and
+	   only the first n values are copied out */
+	m = ((n + k->block - 1) / k->block) * k->block;
+	memcpy(buf[0], a, n * sizeof(*a));
+	for(i = n; i < m; i++)
+		buf[0][i] = INT_MAX;
+	run = k->sort_blocks(buf[0], m);
+	res = merge_passes(buf[0], buf[1], m, run, k->merge);
+	memcpy(a, res, n * sizeof(*a));
+	return (TRUE);
+}
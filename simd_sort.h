@@ -0,0 +1,74 @@
+/**
+* @file simd_sort.h
+* @brief Sorting networks and merge kernels for small int arrays. Blocks of
+*        64 (AVX2) or 16 (SSE4.1) values are sorted with a column sorting
+*        network plus a transpose, and sorted runs are combined with a
+*        bitonic merge network that emits 8 (or 4) values per step. None of
+*        it has a data dependent branch except the choice of which run to
+*        load from next, so there is nothing for the predictor to miss.
+*
+*        The instruction set is picked once at startup with
+*        __builtin_cpu_supports(); CPUs with neither get plain C. Nothing
+*        has to be built with -mavx2.
+*/
+
+#ifndef _SIMD_SORT_H_
+#define _SIMD_SORT_H_
+
+#include "heapsort.h"
+
+/** Largest input simd_sort() handles without allocating */
+#define SIMD_SORT_MAX	(256)
+
+/** Kernels, best last */
+typedef enum _simd_isa
+{
+	SIMD_SCALAR = 0,
+	SIMD_SSE41,
+	SIMD_AVX2,
+	SIMD_ISA_COUNT
+}simd_isa;
+
+/*!*******************************************************
+*	\fn simd_sort(int *a, size_t n)
+*	\brief - sort a[] ascending. Inputs up to SIMD_SORT_MAX use two stack
+*		 buffers; larger ones are sorted in SIMD_SORT_MAX blocks and
+*		 merged through one heap buffer.
+*	\param a - array to sort
+*	\param n - number of elements
+*	\return bool - FALSE if out of memory (only for n > SIMD_SORT_MAX,
+*		 a[] is then left unsorted)
+*********************************************************/
+bool simd_sort(int *a, size_t n);
+
+/*!*******************************************************
+*	\fn simd_merge(const int *a, size_t na, const int *b, size_t nb, int *out)
+*	\brief - merge two ascending runs
+*	\param a - first run
+*	\param na - length of a
+*	\param b - second run
+*	\param nb - length of b
+*	\param out - na + nb slots, must not overlap a or b
+*	\return void
+*********************************************************/
+void simd_merge(const int *a, size_t na, const int *b, size_t nb, int *out);
+
+/*!*******************************************************
+*	\fn simd_sort_isa(void)
+*	\brief - kernel in use
+*	\return simd_isa - SIMD_SCALAR, SIMD_SSE41 or SIMD_AVX2
+*********************************************************/
+simd_isa simd_sort_isa(void);
+
+/*!*******************************************************
+*	\fn simd_sort_set_isa(simd_isa isa)
+*	\brief - switch kernels, for benchmarks and tests. Not thread safe.
+*	\param isa - kernel to use
+*	\return bool - FALSE if this CPU can't run it (nothing changes then)
+*********************************************************/
+bool simd_sort_set_isa(simd_isa isa);
+
+/** Printable kernel names, indexed by simd_isa */
+extern const char *simd_isa_name[SIMD_ISA_COUNT];
+
+#endif // _SIMD_SORT_H_
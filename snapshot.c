@@ -0,0 +1,328 @@
+/**
+* @file snapshot.c
+* @brief Save and mmap() load of tree and list snapshots
+*/
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "snapshot.h"
+
+/** FNV-1a 64 bit parameters */
+#define SNAP_FNV_OFFSET		(0xcbf29ce484222325ull)
+#define SNAP_FNV_PRIME		(0x100000001b3ull)
+
+/** Initial size of the BFS queue used by snap_save() */
+#define SNAP_QUEUE_INIT		(1024)
+
+/**
+	\brief struct snap_qent: snap_save() queue entry
+*/
+typedef struct snap_qent
+{
+	node *n;
+	/** Index of the node that queued it */
+	uint32_t parent;
+}snap_qent;
+
+/*!*******************************************************
+*	\fn snap_hash(uint64_t h, const void *buf, size_t len)
+*	\brief - continue an FNV-1a hash over buf
+*	\param h - hash so far, SNAP_FNV_OFFSET to start
+*	\param buf - bytes to add
+*	\param len - number of bytes
+*	\return uint64_t - updated hash
+*********************************************************/
+static uint64_t snap_hash(uint64_t h, const void *buf, size_t len)
+{
+	const unsigned char *p = (const unsigned char*) buf;
+	size_t i = 0;
+
+	for(i = 0; i < len; i++)
+	{
+		h ^= p[i];
+		h *= SNAP_FNV_PRIME;
+	}
+	return (h);
+}
+
+/*!*******************************************************
+*	\fn snap_save(const char *path, node *root, snap_kind kind)
+*	\brief - write a snapshot of a tree or list. The file is written next
+*		 to path and renamed over it, so a crash never leaves a torn
+*		 snapshot behind.
+*	\param path - snapshot file
+*	\param root - tree root or list head, may be NULL
+*	\param kind - how the nodes are linked
+*	\return bool - FALSE on I/O error or out of memory
+*********************************************************/
+bool snap_save(const char *path, node *root, snap_kind kind)
+{
+	size_t plen = strlen(path);
+	char *tmp = (char*) malloc(plen + 5);
+	snap_qent *queue = (snap_qent*) malloc(SNAP_QUEUE_INIT * sizeof(*queue));
+	size_t cap = SNAP_QUEUE_INIT;
+	size_t head = 0;
+	size_t tail = 0;
+	snap_header hdr;
+	snap_node rec;
+	FILE *fp = NULL;
+	node *n = NULL;
+	bool ok = FALSE;
+	int i = 0;
+
+	if((NULL == tmp) || (NULL == queue))
+		goto out;
+	memcpy(tmp, path, plen);
+	memcpy(tmp + plen, ".tmp", 5);
+	fp = fopen(tmp, "wb");
+	if(NULL == fp)
+		goto out;
+
+	/* Header goes in last, once count and checksum are known */
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = SNAP_MAGIC;
+	hdr.version = SNAP_VERSION;
+	hdr.kind = (uint16_t) kind;
+	hdr.node_size = sizeof(snap_node);
+	hdr.checksum = SNAP_FNV_OFFSET;
+	if(1 != fwrite(&hdr, sizeof(hdr), 1, fp))
+		goto out;
+
+	/* A node's index is its position in the queue, so the indices of its
+	   links are known as soon as they are queued and every record can be
+	   written out the moment it is dequeued. Lists only ever queue NEXT.
+	   Indices are 32 bit; SNAP_NIL itself is never handed out. */
+	if(NULL != root)
+	{
+		queue[tail].n = root;
+		queue[tail++].parent = SNAP_NIL;
+	}
+	while(head < tail)
+	{
+		n = queue[head].n;
+		rec.data = n->data;
+		rec.size = (SNAP_LIST == kind) ? 1 : n->size;
+		rec.parent = queue[head].parent;
+		for(i = 0; i < NUM_LINKS; i++)
+		{
+			rec.link[i] = SNAP_NIL;
+			if((NULL == n->link[i]) || ((SNAP_LIST == kind) && (NEXT != i)))
+				continue;
+			if(SNAP_NIL == tail)
+				goto out;
+			if(tail == cap)
+			{
+				snap_qent *grown = (snap_qent*) realloc(queue, 2 * cap * sizeof(*queue));
+				if(NULL == grown)
+					goto out;
+				queue = grown;
+				cap *= 2;
+			}
+			rec.link[i] = (uint32_t) tail;
+			queue[tail].n = n->link[i];
+			queue[tail++].parent = (SNAP_LIST == kind) ? SNAP_NIL : (uint32_t) head;
+		}
+		if(SNAP_LIST == kind)
+			rec.link[PREV] = (0 == head) ? SNAP_NIL : (uint32_t)(head - 1);
+		head++;
+		hdr.checksum = snap_hash(hdr.checksum, &rec, sizeof(rec));
+		if(1 != fwrite(&rec, sizeof(rec), 1, fp))
+			goto out;
+	}
+
+	hdr.count = tail;
+	if((0 != fseek(fp, 0, SEEK_SET)) || (1 != fwrite(&hdr, sizeof(hdr), 1, fp)))
+		goto out;
+	if((0 != fflush(fp)) || (0 != fsync(fileno(fp))))
+		goto out;
+	ok = TRUE;
+
+out:
+	if(NULL != fp)
+	{
+		if(0 != fclose(fp))
+			ok = FALSE;
+		if(TRUE == ok)
+			ok = (0 == rename(tmp, path)) ? TRUE : FALSE;
+		if(FALSE == ok)
+			unlink(tmp);
+	}
+	free(queue);
+	free(tmp);
+	return (ok);
+}
+
+/*!*******************************************************
+*	\fn snap_map(snapshot *s, const char *path, int flags)
+*	\brief - map a snapshot and check its header
+*	\param s - filled in on success
+*	\param path - snapshot file
+*	\param flags - SNAP_COW, SNAP_VERIFY
+*	\return bool - FALSE if the file can't be mapped, has the wrong
+*		 magic or version, is truncated or fails the checksum
+*********************************************************/
+bool snap_map(snapshot *s, const char *path, int flags)
+{
+	int fd = open(path, O_RDONLY);
+	struct stat st;
+	void *map = MAP_FAILED;
+	snap_header *hdr = NULL;
+	size_t len = 0;
+
+	if(fd < 0)
+		return (FALSE);
+	if((0 != fstat(fd, &st)) || ((size_t) st.st_size < sizeof(snap_header)))
+	{
+		close(fd);
+		return (FALSE);
+	}
+	len = (size_t) st.st_size;
+
+	/* A private mapping is copy-on-write: pages the caller writes to get
+	   their own copy and the file is never touched */
+	if(0 != (flags & SNAP_COW))
+		map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	else
+		map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+	/* The mapping keeps its own reference to the file */
+	close(fd);
+	if(MAP_FAILED == map)
+		return (FALSE);
+
+	hdr = (snap_header*) map;
+	if((SNAP_MAGIC != hdr->magic) || (SNAP_VERSION != hdr->version) ||
+	   (sizeof(snap_node) != hdr->node_size) ||
+	   (hdr->count > (len - sizeof(snap_header)) / sizeof(snap_node)))
+		goto bad;
+	if((0 != (flags & SNAP_VERIFY)) &&
+	   (hdr->checksum != snap_hash(SNAP_FNV_OFFSET, hdr + 1, hdr->count * sizeof(snap_node))))
+		goto bad;
+
+	s->hdr = hdr;
+	s->nodes = (snap_node*)(hdr + 1);
+	s->len = len;
+	return (TRUE);
+
+bad:
+	munmap(map, len);
+	return (FALSE);
+}
+
+/*!*******************************************************
+*	\fn snap_find(const snapshot *s, int data)
+*	\brief - find_node() on the mapped image. Search trees are descended,
+*		 heaps and lists are scanned in file order. Link indices are
+*		 trusted; map files of unknown origin with SNAP_VERIFY.
+*	\param s - mapped snapshot
+*	\param data - value to look for
+*	\return uint32_t - index of a node holding data, SNAP_NIL if none
+*********************************************************/
+uint32_t snap_find(const snapshot *s, int data)
+{
+	const snap_node *nodes = s->nodes;
+	uint64_t count = s->hdr->count;
+	uint32_t i = 0;
+
+	if(0 == count)
+		return (SNAP_NIL);
+
+	if(SNAP_BST == s->hdr->kind)
+	{
+		/* Same walk as find_node(), equal keys go left */
+		while((SNAP_NIL != i) && (nodes[i].data != data))
+			i = nodes[i].link[DIR(data, nodes[i].data)];
+		return (i);
+	}
+
+	/* A heap only orders parent against child and a list has to be walked
+	   anyway; the records are contiguous, so a straight scan beats
+	   chasing links */
+	for(i = 0; i < count; i++)
+	{
+		if(nodes[i].data == data)
+			return (i);
+	}
+	return (SNAP_NIL);
+}
+
+/*!*******************************************************
+*	\fn snap_restore(const snapshot *s, node **root)
+*	\brief - rebuild the pointer structure, for callers that need to
+*		 modify it with the regular node functions
+*	\param s - mapped snapshot
+*	\param root - out: tree root or list head
+*	\return bool - FALSE if out of memory or a link is out of range
+*		 (nothing is allocated then)
+*********************************************************/
+bool snap_restore(const snapshot *s, node **root)
+{
+	const snap_node *rec = s->nodes;
+	size_t count = (size_t) s->hdr->count;
+	node **map = NULL;
+	size_t i = 0;
+	int j = 0;
+
+	*root = NULL;
+	if(0 == count)
+		return (TRUE);
+	map = (node**) malloc(count * sizeof(*map));
+	if(NULL == map)
+		return (FALSE);
+
+	/* Every node is its own allocation, free_tree() and friends free()
+	   them one at a time */
+	for(i = 0; i < count; i++)
+	{
+		map[i] = (node*) malloc(sizeof(node));
+		if(NULL == map[i])
+		{
+			while(i > 0)
+				free(map[--i]);
+			free(map);
+			return (FALSE);
+		}
+	}
+	/* An index past the end can only come from a damaged file that was
+	   mapped without SNAP_VERIFY; don't follow it */
+	for(i = 0; i < count; i++)
+	{
+		for(j = 0; j < NUM_LINKS; j++)
+			if((SNAP_NIL != rec[i].link[j]) && (rec[i].link[j] >= count))
+				break;
+		if((j < NUM_LINKS) || ((SNAP_NIL != rec[i].parent) && (rec[i].parent >= count)))
+		{
+			for(i = 0; i < count; i++)
+				free(map[i]);
+			free(map);
+			return (FALSE);
+		}
+	}
+	for(i = 0; i < count; i++)
+	{
+		map[i]->data = rec[i].data;
+		map[i]->size = rec[i].size;
+		map[i]->parent = (SNAP_NIL == rec[i].parent) ? NULL : map[rec[i].parent];
+		for(j = 0; j < NUM_LINKS; j++)
+			map[i]->link[j] = (SNAP_NIL == rec[i].link[j]) ? NULL : map[rec[i].link[j]];
+	}
+	*root = map[0];
+	free(map);
+	return (TRUE);
+}
+
+/*!*******************************************************
+*	\fn snap_unmap(snapshot *s)
+*	\brief - release a mapping made by snap_map()
+*	\param s - mapped snapshot
+*	\return void
+*********************************************************/
+void snap_unmap(snapshot *s)
+{
+	if(NULL != s->hdr)
+		munmap(s->hdr, s->len);
+	s->hdr = NULL;
+	s->nodes = NULL;
+	s->len = 0;
+}
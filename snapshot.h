@@ -0,0 +1,140 @@
+/**
+* @file snapshot.h
+* @brief On-disk snapshots of a heap, search tree or linked list that load
+*        with a single mmap() and no parsing. Nodes are stored as a flat
+*        array and link to each other by array index instead of by pointer,
+*        so the file means the same thing wherever it is mapped.
+*
+*        Layout: one snap_header, then snap_header.count snap_node records
+*        in BFS order (trees, root first) or list order (lists, head first).
+*        Integers are in host byte order; a file written on a host of the
+*        other endianness fails the magic check.
+*/
+
+#ifndef _SNAPSHOT_H_
+#define _SNAPSHOT_H_
+
+#include <stdint.h>
+#include "heapsort.h"
+
+/** "HSNP" */
+#define SNAP_MAGIC		(0x504e5348u)
+
+/** Bumped whenever snap_header or snap_node change */
+#define SNAP_VERSION		(1)
+
+/** Link value standing in for NULL */
+#define SNAP_NIL		(UINT32_MAX)
+
+/** snap_map() flags. Without SNAP_COW the mapping is read-only. */
+#define SNAP_COW		(1 << 0)	/**< private writable mapping, writes never reach the file */
+#define SNAP_VERIFY		(1 << 1)	/**< check the payload checksum (reads the whole file) */
+
+/** What the nodes in a snapshot were linked as */
+typedef enum _snap_kind
+{
+	SNAP_HEAP = 1,		/**< add_node() with HEAPSORT */
+	SNAP_BST,		/**< add_node() without HEAPSORT */
+	SNAP_LIST		/**< llist.c, link[NEXT]/link[PREV] */
+}snap_kind;
+
+/**
+	\brief struct snap_header: first 64 bytes of a snapshot file
+*/
+typedef struct snap_header
+{
+	uint32_t magic;
+	uint16_t version;
+	/** snap_kind */
+	uint16_t kind;
+	/** sizeof(snap_node) of the writer */
+	uint32_t node_size;
+	uint32_t reserved;
+	/** Number of snap_node records */
+	uint64_t count;
+	/** FNV-1a over the snap_node records */
+	uint64_t checksum;
+	uint8_t pad[32];
+}snap_header;
+
+/**
+	\brief struct snap_node: struct node with array indices for pointers
+*/
+typedef struct snap_node
+{
+	int32_t data;
+	/** Subtree size (trees), 1 (lists) */
+	uint32_t size;
+	/** Indices of link[LEFT]/link[RIGHT] or link[PREV]/link[NEXT], SNAP_NIL for NULL */
+	uint32_t link[NUM_LINKS];
+	/** Index of the parent (trees), SNAP_NIL for the root and for lists */
+	uint32_t parent;
+}snap_node;
+
+/**
+	\brief struct snapshot: a mapped snapshot file
+*/
+typedef struct snapshot
+{
+	/** Start of the mapping */
+	snap_header *hdr;
+	/** hdr->count records, node 0 is the root or list head */
+	snap_node *nodes;
+	/** Mapping length in bytes */
+	size_t len;
+}snapshot;
+
+/*!*******************************************************
+*	\fn snap_save(const char *path, node *root, snap_kind kind)
+*	\brief - write a snapshot of a tree or list. The file is written next
+*		 to path and renamed over it, so a crash never leaves a torn
+*		 snapshot behind.
+*	\param path - snapshot file
+*	\param root - tree root or list head, may be NULL
+*	\param kind - how the nodes are linked
+*	\return bool - FALSE on I/O error or out of memory
+*********************************************************/
+bool snap_save(const char *path, node *root, snap_kind kind);
+
+/*!*******************************************************
+*	\fn snap_map(snapshot *s, const char *path, int flags)
+*	\brief - map a snapshot and check its header
+*	\param s - filled in on success
+*	\param path - snapshot file
+*	\param flags - SNAP_COW, SNAP_VERIFY
+*	\return bool - FALSE if the file can't be mapped, has the wrong
+*		 magic or version, is truncated or fails the checksum
+*********************************************************/
+bool snap_map(snapshot *s, const char *path, int flags);
+
+/*!*******************************************************
+*	\fn snap_find(const snapshot *s, int data)
+*	\brief - find_node() on the mapped image. Search trees are descended,
+*		 heaps and lists are scanned in file order. Link indices are
+*		 trusted; map files of unknown origin with SNAP_VERIFY.
+*	\param s - mapped snapshot
+*	\param data - value to look for
+*	\return uint32_t - index of a node holding data, SNAP_NIL if none
+*********************************************************/
+uint32_t snap_find(const snapshot *s, int data);
+
+/*!*******************************************************
+*	\fn snap_restore(const snapshot *s, node **root)
+*	\brief - rebuild the pointer structure, for callers that need to
+*		 modify it with the regular node functions
+*	\param s - mapped snapshot
+*	\param root - out: tree root or list head
+*	\return bool - FALSE if out of memory or a link is out of range
+*		 (nothing is allocated then)
+*********************************************************/
+bool snap_restore(const snapshot *s, node **root);
+
+/*!*******************************************************
+*	\fn snap_unmap(snapshot *s)
+*	\brief - release a mapping made by snap_map()
+*	\param s - mapped snapshot
+*	\return void
+*********************************************************/
+void snap_unmap(snapshot *s);
+
+#endif // _SNAPSHOT_H_
@@ -0,0 +1,92 @@
+/**
+* @file stable_sort.c
+* @brief Stable heapsort on packed (key, position) words
+*/
+
+#include "stable_sort.h"
+#include "heap_generic.h"
+#include "record_sort.h"
+
+GEN_HEAP(stable, uint64_t, KEY_LT)
+
+/*!*******************************************************
+*	\fn stable_sorted_words(const char *base, size_t n, size_t stride)
+*	\brief - pack and heapsort the keys
+*	\param base - first key
+*	\param n - number of keys
+*	\param stride - bytes from one key to the next
+*	\return uint64_t * - sorted packed words (caller frees), NULL on failure
+*********************************************************/
+static uint64_t* stable_sorted_words(const char *base, size_t n, size_t stride)
+{
+	uint64_t *w = NULL;
+	size_t i = 0;
+	int key = 0;
+
+	if(n > STABLE_SORT_MAX)
+		return (NULL);
+	w = (uint64_t*) malloc((n ? n : 1) * sizeof(*w));
+	if(NULL == w)
+		return (NULL);
+	for(i = 0; i < n; i++)
+	{
+		memcpy(&key, base + (i * stride), sizeof(key));
+		w[i] = stable_pack(key, (uint32_t) i);
+	}
+	stable_heapsort(w, n);
+	return (w);
+}
+
+/*!*******************************************************
+*	\fn stable_sort_index(const int *keys, size_t n, uint32_t *order)
+*	\brief - stable sorted order of keys, for sorting records that
+*		 carry an int key
+*	\param keys - n keys
+*	\param n - number of keys, at most STABLE_SORT_MAX
+*	\param order - out: order[i] is the input index of the i-th record
+*	\return bool - FALSE if out of memory or n is too large
+*********************************************************/
+bool stable_sort_index(const int *keys, size_t n, uint32_t *order)
+{
+	uint64_t *w = stable_sorted_words((const char*) keys, n, sizeof(*keys));
+	size_t i = 0;
+
+	if(NULL == w)
+		return (FALSE);
+	for(i = 0; i < n; i++)
+		order[i] = stable_seq(w[i]);
+	free(w);
+	return (TRUE);
+}
+
+/*!*******************************************************
+*	\fn stable_sort_records(void *recs, size_t n, size_t rec_size, size_t key_off)
+*	\brief - sort records in place on an int field; records with equal
+*		 keys keep their input order. Each record is moved once, by
+*		 record_permute().
+*	\param recs - array of n records
+*	\param n - number of records, at most STABLE_SORT_MAX
+*	\param rec_size - size of one record in bytes
+*	\param key_off - offset of the int key inside a record
+*	\return bool - FALSE if out of memory or n is too large
+*********************************************************/
+bool stable_sort_records(void *recs, size_t n, size_t rec_size, size_t key_off)
+{
+	uint32_t *order = (uint32_t*) malloc((n ? n : 1) * sizeof(*order));
+	uint64_t *w = NULL;
+	bool ok = FALSE;
+	size_t i = 0;
+
+	if(NULL == order)
+		return (FALSE);
+	w = stable_sorted_words((const char*) recs + key_off, n, rec_size);
+	if(NULL != w)
+	{
+		for(i = 0; i < n; i++)
+			order[i] = stable_seq(w[i]);
+		free(w);
+		ok = record_permute(recs, n, rec_size, order);
+	}
+	free(order);
+	return (ok);
+}
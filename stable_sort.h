@@ -0,0 +1,83 @@
+/**
+* @file stable_sort.h
+* @brief Stable heapsort for records with an int key. Each key is packed
+*        together with its input position into one 64 bit word (key in the
+*        high half, position in the low half), so a single integer compare
+*        orders by key and then by arrival; equal keys come out in input
+*        order without any extra branch in the heap.
+*
+*        Stability is only visible through what travels with the key, so
+*        there is no bare int entry point: sort the index, or the records.
+*/
+
+#ifndef _STABLE_SORT_H_
+#define _STABLE_SORT_H_
+
+#include <stdint.h>
+#include "heapsort.h"
+
+/** Largest input stable_sort_index() and stable_sort_records() accept,
+    the position has 32 bits */
+#define STABLE_SORT_MAX		((size_t) UINT32_MAX + 1)
+
+/*!*******************************************************
+*	\fn stable_pack(int key, uint32_t seq)
+*	\brief - pack key and position into one order preserving word.
+*		 Flipping the sign bit makes signed keys compare correctly
+*		 as unsigned.
+*	\param key - sort key
+*	\param seq - input position
+*	\return uint64_t - packed word
+*********************************************************/
+static inline uint64_t stable_pack(int key, uint32_t seq)
+{
+	return (((uint64_t)((uint32_t) key ^ 0x80000000u) << 32) | seq);
+}
+
+/*!*******************************************************
+*	\fn stable_key(uint64_t w)
+*	\brief - key back out of a packed word
+*	\param w - packed word
+*	\return int - key
+*********************************************************/
+static inline int stable_key(uint64_t w)
+{
+	return ((int)((uint32_t)(w >> 32) ^ 0x80000000u));
+}
+
+/*!*******************************************************
+*	\fn stable_seq(uint64_t w)
+*	\brief - input position back out of a packed word
+*	\param w - packed word
+*	\return uint32_t - position
+*********************************************************/
+static inline uint32_t stable_seq(uint64_t w)
+{
+	return ((uint32_t) w);
+}
+
+/*!*******************************************************
+*	\fn stable_sort_index(const int *keys, size_t n, uint32_t *order)
+*	\brief - stable sorted order of keys, for sorting records that
+*		 carry an int key
+*	\param keys - n keys
+*	\param n - number of keys, at most STABLE_SORT_MAX
+*	\param order - out: order[i] is the input index of the i-th record
+*	\return bool - FALSE if out of memory or n is too large
+*********************************************************/
+bool stable_sort_index(const int *keys, size_t n, uint32_t *order);
+
+/*!*******************************************************
+*	\fn stable_sort_records(void *recs, size_t n, size_t rec_size, size_t key_off)
+*	\brief - sort records in place on an int field; records with equal
+*		 keys keep their input order. Each record is moved once, by
+*		 record_permute().
+*	\param recs - array of n records
+*	\param n - number of records, at most STABLE_SORT_MAX
+*	\param rec_size - size of one record in bytes
+*	\param key_off - offset of the int key inside a record
+*	\return bool - FALSE if out of memory or n is too large
+*********************************************************/
+bool stable_sort_records(void *recs, size_t n, size_t rec_size, size_t key_off);
+
+#endif // _STABLE_SORT_H_
@@ -0,0 +1,76 @@
+/**
+* @file str_key.c
+* @brief String key helpers for the prefix caching heap and tree
+*/
+
+#include "str_key.h"
+
+/*!*******************************************************
+*	\fn str_common_prefix(const char **strs, size_t n)
+*	\brief - length of the prefix shared by all strings, usable as skip
+*	\param strs - strings
+*	\param n - number of strings
+*	\return size_t - shared prefix length
+*********************************************************/
+size_t str_common_prefix(const char **strs, size_t n)
+{
+	size_t len = 0;
+	size_t i = 0;
+
+	if(0 == n)
+		return (0);
+	len = strlen(strs[0]);
+	for(i = 1; (i < n) && (0 != len); i++)
+	{
+		size_t j = 0;
+		while((j < len) && (strs[i][j] == strs[0][j]))
+			j++;
+		len = j;
+	}
+	return (len);
+}
+
+/*!*******************************************************
+*	\fn str_sort(const char **strs, size_t n)
+*	\brief - sort the string pointers in strcmp() order. Skips the
+*		 shared prefix so the inline prefixes actually differ.
+*	\param strs - strings, reordered in place
+*	\param n - number of strings
+*	\return bool - FALSE if out of memory
+*********************************************************/
+bool str_sort(const char **strs, size_t n)
+{
+	size_t skip = str_common_prefix(strs, n);
+	str_key *keys = NULL;
+	size_t i = 0;
+
+	if(0 == n)
+		return (TRUE);
+	keys = (str_key*) malloc(n * sizeof(*keys));
+	if(NULL == keys)
+		return (FALSE);
+
+	for(i = 0; i < n; i++)
+		keys[i] = str_key_make(strs[i], skip);
+	skey_heapsort(keys, n);
+	for(i = 0; i < n; i++)
+		strs[i] = keys[i].str - skip;
+	free(keys);
+	return (TRUE);
+}
+
+/*!*******************************************************
+*	\fn skey_find_str(skey_node *root, const char *s, size_t skip)
+*	\brief - find_node() for a string key tree
+*	\param root - tree root
+*	\param s - string to look for
+*	\param skip - skip the tree was built with
+*	\return skey_node * - node if found, NULL otherwise
+*********************************************************/
+skey_node* skey_find_str(skey_node *root, const char *s, size_t skip)
+{
+	/* The lookup key might not share the tree's prefix at all */
+	if(0 != strncmp(s, (NULL != root) ? root->data.str - skip : s, skip))
+		return (NULL);
+	return (skey_find_node(root, str_key_make(s, skip)));
+}
@@ -0,0 +1,116 @@
+/**
+* @file str_key.h
+* @brief String keys for the generic heap and tree (see heap_generic.h).
+*        Every key carries the first 8 bytes of its string packed into a
+*        uint64_t, so most comparisons are a single integer compare on data
+*        already sitting in the heap slot or tree node. The string itself is
+*        only read when two prefixes tie.
+*
+*        Keys with a long shared prefix (URLs, IDs) would tie all the time,
+*        so the inline prefix can start after a prefix common to every key in
+*        the container; str_common_prefix() finds it. The key then points
+*        past that prefix, so the skip is kept once by the container rather
+*        than in every slot, and a key stays 16 bytes.
+*/
+
+#ifndef _STR_KEY_H_
+#define _STR_KEY_H_
+
+#include <stdint.h>
+#include "heap_generic.h"
+
+/**
+	\brief struct str_key: string pointer plus its normalized 8 byte prefix
+*/
+typedef struct str_key
+{
+	/** First 8 bytes of str, big endian, zero padded */
+	uint64_t prefix;
+	/** The string past the skip bytes shared by the container, not
+	    copied; the full string is str - skip */
+	const char *str;
+}str_key;
+
+/*!*******************************************************
+*	\fn str_key_make(const char *s, size_t skip)
+*	\brief - build the key for s. All keys compared with each other
+*		 must be built with the same skip, and skip must not be
+*		 larger than the prefix they all share. The key's str is
+*		 s + skip.
+*	\param s - NUL terminated string
+*	\param skip - length of the prefix shared by every key
+*	\return str_key - key for s
+*********************************************************/
+static inline str_key str_key_make(const char *s, size_t skip)
+{
+	str_key k;
+	const unsigned char *p = (const unsigned char*) s + skip;
+	int i = 0;
+
+	k.prefix = 0;
+	k.str = s + skip;
+	for(i = 0; i < 8; i++)
+	{
+		k.prefix <<= 8;
+		if(0 != *p)
+			k.prefix |= *p++;
+	}
+	return (k);
+}
+
+/*!*******************************************************
+*	\fn str_key_cmp(const str_key *a, const str_key *b)
+*	\brief - strcmp() order of the two keys
+*	\param a - first key
+*	\param b - second key
+*	\return int - <0, 0 or >0 like strcmp()
+*********************************************************/
+static inline int str_key_cmp(const str_key *a, const str_key *b)
+{
+	if(a->prefix != b->prefix)
+		return ((a->prefix < b->prefix) ? -1 : 1);
+	/* Same prefix and it ends in a NUL: both strings ended inside it */
+	if(0 == (a->prefix & 0xff))
+		return (0);
+	/* Otherwise both have all 8 bytes, and everything before them is
+	   equal: the shared prefix and the inline bytes */
+	return (strcmp(a->str + 8, b->str + 8));
+}
+
+/** Comparison macro for GEN_HEAP/GEN_TREE */
+#define STR_KEY_LT(a, b) \
+	(((a).prefix != (b).prefix) ? ((a).prefix < (b).prefix) : (str_key_cmp(&(a), &(b)) < 0))
+
+GEN_HEAP(skey, str_key, STR_KEY_LT)
+GEN_TREE(skey, str_key, STR_KEY_LT)
+
+/*!*******************************************************
+*	\fn str_common_prefix(const char **strs, size_t n)
+*	\brief - length of the prefix shared by all strings, usable as skip
+*	\param strs - strings
+*	\param n - number of strings
+*	\return size_t - shared prefix length
+*********************************************************/
+size_t str_common_prefix(const char **strs, size_t n);
+
+/*!*******************************************************
+*	\fn str_sort(const char **strs, size_t n)
+*	\brief - sort the string pointers in strcmp() order. Skips the
+*		 shared prefix so the inline prefixes actually differ.
+*	\param strs - strings, reordered in place
+*	\param n - number of strings
+*	\return bool - FALSE if out of memory
+*********************************************************/
+bool str_sort(const char **strs, size_t n);
+
+/*!*******************************************************
+*	\fn skey_find_str(skey_node *root, const char *s, size_t skip)
+*	\brief - find_node() for a string key tree
+*	\param root - tree root
+*	\param s - string to look for
+*	\param skip - skip the tree was built with
+*	\return skey_node * - node if found, NULL otherwise
+*********************************************************/
+skey_node* skey_find_str(skey_node *root, const char *s, size_t skip);
+
+#endif // _STR_KEY_H_
@@ -0,0 +1,326 @@
+/**
+* @file timerq.c
+* @brief Timer wheel in front of a min-heap
+*/
+
+#include "timerq.h"
+
+/** Bitmap words in timerq.busy */
+#define TQ_WORDS		(TQ_WHEEL_SLOTS / 64)
+
+/** Slot of a tick */
+#define TQ_SLOT(tick)		((size_t)((tick) & (TQ_WHEEL_SLOTS - 1)))
+
+/*!*******************************************************
+*	\fn slot_push(timerq *q, size_t idx, const timer_ev *ev)
+*	\brief - append a timer to a wheel slot
+*	\param q - queue
+*	\param idx - slot
+*	\param ev - timer
+*	\return bool - FALSE if out of memory
+*********************************************************/
+static bool slot_push(timerq *q, size_t idx, const timer_ev *ev)
+{
+	tq_slot *s = &q->slot[idx];
+
+	if(s->n == s->cap)
+	{
+		size_t cap = (0 == s->cap) ? 8 : (2 * s->cap);
+		timer_ev *v = (timer_ev*) realloc(s->v, cap * sizeof(*v));
+		if(NULL == v)
+			return (FALSE);
+		s->v = v;
+		s->cap = cap;
+	}
+	s->v[s->n++] = *ev;
+	q->busy[idx / 64] |= (1ull << (idx % 64));
+	q->wheel_count++;
+	return (TRUE);
+}
+
+/*!*******************************************************
+*	\fn place(timerq *q, const timer_ev *ev)
+*	\brief - put a timer in the wheel if it falls inside it, else in
+*		 the heap. Overdue timers go to the current slot.
+*	\param q - queue
+*	\param ev - timer
+*	\return bool - FALSE if out of memory
+*********************************************************/
+static bool place(timerq *q, const timer_ev *ev)
+{
+	if(ev->deadline >= (q->now + TQ_WHEEL_SLOTS))
+		return (tev_heap_push(&q->far, *ev));
+	if(ev->deadline < q->now)
+		return (slot_push(q, TQ_SLOT(q->now), ev));
+	return (slot_push(q, TQ_SLOT(ev->deadline), ev));
+}
+
+/*!*******************************************************
+*	\fn migrate(timerq *q)
+*	\brief - move the heap timers the wheel now reaches into the wheel
+*	\param q - queue
+*	\return void
+*********************************************************/
+static void migrate(timerq *q)
+{
+	timer_ev ev;
+
+	while((0 != q->far.n) && (q->far.v[0].deadline < (q->now + TQ_WHEEL_SLOTS)))
+	{
+		/* Out of memory: leave it in the heap. pop_until and peek look
+		   at the heap top as well as the wheel, so it still fires. */
+		if(FALSE == slot_push(q, TQ_SLOT(q->far.v[0].deadline), &q->far.v[0]))
+			return;
+		tev_heap_pop(&q->far, &ev);
+	}
+}
+
+/*!*******************************************************
+*	\fn next_busy(const timerq *q)
+*	\brief - ticks from now to the first slot holding timers. Only
+*		 called while the wheel is not empty.
+*	\param q - queue
+*	\return size_t - distance, 0 .. TQ_WHEEL_SLOTS - 1
+*********************************************************/
+static size_t next_busy(const timerq *q)
+{
+	size_t start = TQ_SLOT(q->now);
+	size_t w = 0;
+	size_t k = 0;
+	uint64_t bits = 0;
+
+	/* Word holding start, the words after it, then the wrapped around
+	   low part of the first word again */
+	for(k = 0; k <= TQ_WORDS; k++)
+	{
+		w = ((start / 64) + k) % TQ_WORDS;
+		bits = q->busy[w];
+		if(0 == k)
+			bits &= (~0ull << (start % 64));
+		else if(TQ_WORDS == k)
+			bits &= ((1ull << (start % 64)) - 1);
+		if(0 != bits)
+			return (((w * 64) + (size_t) __builtin_ctzll(bits) - start) & (TQ_WHEEL_SLOTS - 1));
+	}
+	return (0);
+}
+
+/*!*******************************************************
+*	\fn timerq_init(timerq *q, uint64_t now)
+*	\brief - set up an empty queue
+*	\param q - queue
+*	\param now - current tick
+*	\return void
+*********************************************************/
+void timerq_init(timerq *q, uint64_t now)
+{
+	memset(q, 0, sizeof(*q));
+	q->now = now;
+}
+
+/*!*******************************************************
+*	\fn timerq_push(timerq *q, uint64_t deadline, uint64_t id)
+*	\brief - arm a timer. A deadline already behind the queue fires on
+*		 the next timerq_pop_until().
+*	\param q - queue
+*	\param deadline - tick it is due at
+*	\param id - handed back when it fires
+*	\return bool - FALSE if out of memory
+*********************************************************/
+bool timerq_push(timerq *q, uint64_t deadline, uint64_t id)
+{
+	timer_ev ev;
+
+	ev.deadline = deadline;
+	ev.id = id;
+	return (place(q, &ev));
+}
+
+/*!*******************************************************
+*	\fn timerq_push_bulk(timerq *q, const timer_ev *ev, size_t n)
+*	\brief - arm a batch of timers. The far ones are appended to the heap
+*		 and fixed up with one heapify when that is cheaper than
+*		 sifting each one up.
+*	\param q - queue
+*	\param ev - timers
+*	\param n - number of timers
+*	\return bool - FALSE if out of memory (some timers may be armed)
+*********************************************************/
+bool timerq_push_bulk(timerq *q, const timer_ev *ev, size_t n)
+{
+	uint64_t limit = q->now + TQ_WHEEL_SLOTS;
+	size_t old = q->far.n;
+	size_t far = 0;
+	size_t total = 0;
+	size_t lg = 0;
+	size_t i = 0;
+
+	for(i = 0; i < n; i++)
+		far += (ev[i].deadline >= limit);
+	if(FALSE == tev_heap_reserve(&q->far, old + far))
+		return (FALSE);
+
+	/* Near ones first: if one fails the heap hasn't been touched yet */
+	for(i = 0; i < n; i++)
+	{
+		if((ev[i].deadline < limit) && (FALSE == place(q, &ev[i])))
+			return (FALSE);
+	}
+	for(i = 0; i < n; i++)
+	{
+		if(ev[i].deadline >= limit)
+			q->far.v[q->far.n++] = ev[i];
+	}
+
+	/* heapify is O(total), sifting up each new one O(far log total) */
+	total = q->far.n;
+	for(lg = 0; (total >> lg) > 1; lg++)
+		;
+	if((far * lg) > total)
+		tev_heapify(q->far.v, total);
+	else
+	{
+		for(i = old; i < total; i++)
+			tev_sift_up(q->far.v, i);
+	}
+	return (TRUE);
+}
+
+/*!*******************************************************
+*	\fn timerq_peek(timerq *q, timer_ev *out)
+*	\brief - earliest pending timer, left in the queue
+*	\param q - queue
+*	\param out - out: the timer
+*	\return bool - FALSE if the queue is empty
+*********************************************************/
+bool timerq_peek(timerq *q, timer_ev *out)
+{
+	tq_slot *s = NULL;
+	size_t i = 0;
+
+	if(0 != q->wheel_count)
+	{
+		/* Only the current slot can mix deadlines (overdue timers), so
+		   take the smallest */
+		s = &q->slot[TQ_SLOT(q->now + next_busy(q))];
+		*out = s->v[s->head];
+		for(i = s->head + 1; i < s->n; i++)
+		{
+			if(s->v[i].deadline < out->deadline)
+				*out = s->v[i];
+		}
+		/* The heap top is only earlier if migrate() ran out of memory */
+		if((0 != q->far.n) && (q->far.v[0].deadline < out->deadline))
+			*out = q->far.v[0];
+		return (TRUE);
+	}
+	if(0 != q->far.n)
+	{
+		*out = q->far.v[0];
+		return (TRUE);
+	}
+	return (FALSE);
+}
+
+/*!*******************************************************
+*	\fn timerq_pop_until(timerq *q, uint64_t t, timer_ev *out, size_t max)
+*	\brief - remove the timers due at or before tick t, slot by slot,
+*		 and advance the queue to t. Call again while it returns
+*		 max to get the rest.
+*	\param q - queue
+*	\param t - current tick, not expected to go backwards
+*	\param out - out: fired timers
+*	\param max - room in out
+*	\return size_t - number of timers written to out
+*********************************************************/
+size_t timerq_pop_until(timerq *q, uint64_t t, timer_ev *out, size_t max)
+{
+	tq_slot *s = NULL;
+	size_t got = 0;
+	size_t take = 0;
+	size_t dist = 0;
+	size_t idx = 0;
+
+	while(got < max)
+	{
+		dist = (0 == q->wheel_count) ? 0 : next_busy(q);
+
+		/* The heap top comes before every wheel slot when the wheel is
+		   empty, or when migrate() couldn't move it for lack of memory */
+		if((0 != q->far.n) && (q->far.v[0].deadline <= t) &&
+		   ((0 == q->wheel_count) || (q->far.v[0].deadline < (q->now + dist))))
+		{
+			/* Turn the wheel straight to it, never backwards */
+			if(q->far.v[0].deadline > q->now)
+			{
+				q->now = q->far.v[0].deadline;
+				migrate(q);
+			}
+			/* Still in the heap: fire it from there */
+			if((0 != q->far.n) && (q->far.v[0].deadline <= q->now))
+				tev_heap_pop(&q->far, &out[got++]);
+			continue;
+		}
+
+		if((0 == q->wheel_count) || ((q->now + dist) > t))
+			break;
+		if(0 != dist)
+		{
+			q->now += dist;
+			migrate(q);
+		}
+
+		/* The whole slot is due, copy out as much as fits */
+		idx = TQ_SLOT(q->now);
+		s = &q->slot[idx];
+		take = s->n - s->head;
+		if(take > (max - got))
+			take = max - got;
+		memcpy(out + got, s->v + s->head, take * sizeof(*out));
+		got += take;
+		s->head += take;
+		q->wheel_count -= take;
+		if(s->head == s->n)
+		{
+			s->head = s->n = 0;
+			q->busy[idx / 64] &= ~(1ull << (idx % 64));
+		}
+	}
+
+	/* Everything due by t is out unless out filled up first. The wheel
+	   stops at t rather than past it, so timers armed for t after this
+	   call still fire on the next one with the same t. */
+	if((got < max) && (q->now < t))
+	{
+		q->now = t;
+		migrate(q);
+	}
+	return (got);
+}
+
+/*!*******************************************************
+*	\fn timerq_count(const timerq *q)
+*	\brief - pending timers
+*	\param q - queue
+*	\return size_t - number of timers armed and not yet fired
+*********************************************************/
+size_t timerq_count(const timerq *q)
+{
+	return (q->wheel_count + q->far.n);
+}
+
+/*!*******************************************************
+*	\fn timerq_free(timerq *q)
+*	\brief - free the queue's memory, pending timers are dropped
+*	\param q - queue
+*	\return void
+*********************************************************/
+void timerq_free(timerq *q)
+{
+	size_t i = 0;
+
+	for(i = 0; i < TQ_WHEEL_SLOTS; i++)
+		free(q->slot[i].v);
+	tev_heap_free(&q->far);
+	memset(q, 0, sizeof(*q));
+}
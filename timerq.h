@@ -0,0 +1,134 @@
+/**
+* @file timerq.h
+* @brief Timer queue for event loops. Near-term timers go into a timer wheel
+*        with one slot per tick, so arming one is an append and firing a
+*        whole tick's worth is a copy. Timers further out than the wheel
+*        spans wait in a min-heap and move into the wheel as it turns.
+*        Everything due is handed back in one call instead of one pop per
+*        timer.
+*/
+
+#ifndef _TIMERQ_H_
+#define _TIMERQ_H_
+
+#include <stdint.h>
+#include "heapsort.h"
+#include "heap_generic.h"
+
+/** Ticks covered by the wheel, has to be a power of 2 and a multiple of 64 */
+#define TQ_WHEEL_SLOTS		(256)
+
+/**
+	\brief struct timer_ev: one timer
+*/
+typedef struct timer_ev
+{
+	/** Tick it is due at */
+	uint64_t deadline;
+	/** Caller's handle, handed back when it fires */
+	uint64_t id;
+}timer_ev;
+
+#define TIMER_EV_LT(a, b)	((a).deadline < (b).deadline)
+
+GEN_HEAP(tev, timer_ev, TIMER_EV_LT)
+
+/**
+	\brief struct tq_slot: timers due at one tick of the wheel
+*/
+typedef struct tq_slot
+{
+	timer_ev *v;
+	/** Timers in v[head..n) are pending, the ones before have fired */
+	size_t head;
+	size_t n;
+	size_t cap;
+}tq_slot;
+
+/**
+	\brief struct timerq: timer queue
+*/
+typedef struct timerq
+{
+	/** First tick the wheel covers; every timer due before it has fired */
+	uint64_t now;
+	/** Timers in the wheel */
+	size_t wheel_count;
+	/** Bit per slot, set while the slot holds pending timers */
+	uint64_t busy[TQ_WHEEL_SLOTS / 64];
+	tq_slot slot[TQ_WHEEL_SLOTS];
+	/** Timers due at now + TQ_WHEEL_SLOTS or later */
+	tev_heap far;
+}timerq;
+
+/*!*******************************************************
+*	\fn timerq_init(timerq *q, uint64_t now)
+*	\brief - set up an empty queue
+*	\param q - queue
+*	\param now - current tick
+*	\return void
+*********************************************************/
+void timerq_init(timerq *q, uint64_t now);
+
+/*!*******************************************************
+*	\fn timerq_push(timerq *q, uint64_t deadline, uint64_t id)
+*	\brief - arm a timer. A deadline already behind the queue fires on
+*		 the next timerq_pop_until().
+*	\param q - queue
+*	\param deadline - tick it is due at
+*	\param id - handed back when it fires
+*	\return bool - FALSE if out of memory
+*********************************************************/
+bool timerq_push(timerq *q, uint64_t deadline, uint64_t id);
+
+/*!*******************************************************
+*	\fn timerq_push_bulk(timerq *q, const timer_ev *ev, size_t n)
+*	\brief - arm a batch of timers. The far ones are appended to the heap
+*		 and fixed up with one heapify when that is cheaper than
+*		 sifting each one up.
+*	\param q - queue
+*	\param ev - timers
+*	\param n - number of timers
+*	\return bool - FALSE if out of memory (some timers may be armed)
+*********************************************************/
+bool timerq_push_bulk(timerq *q, const timer_ev *ev, size_t n);
+
+/*!*******************************************************
+*	\fn timerq_peek(timerq *q, timer_ev *out)
+*	\brief - earliest pending timer, left in the queue
+*	\param q - queue
+*	\param out - out: the timer
+*	\return bool - FALSE if the queue is empty
+*********************************************************/
+bool timerq_peek(timerq *q, timer_ev *out);
+
+/*!*******************************************************
+*	\fn timerq_pop_until(timerq *q, uint64_t t, timer_ev *out, size_t max)
+*	\brief - remove the timers due at or before tick t, slot by slot,
+*		 and advance the queue to t. Call again while it returns
+*		 max to get the rest.
+*	\param q - queue
+*	\param t - current tick, not expected to go backwards
+*	\param out - out: fired timers
+*	\param max - room in out
+*	\return size_t - number of timers written to out
+*********************************************************/
+size_t timerq_pop_until(timerq *q, uint64_t t, timer_ev *out, size_t max);
+
+/*!*******************************************************
+*	\fn timerq_count(const timerq *q)
+*	\brief - pending timers
+*	\param q - queue
+*	\return size_t - number of timers armed and not yet fired
+*********************************************************/
+size_t timerq_count(const timerq *q);
+
+/*!*******************************************************
+*	\fn timerq_free(timerq *q)
+*	\brief - free the queue's memory, pending timers are dropped
+*	\param q - queue
+*	\return void
+*********************************************************/
+void timerq_free(timerq *q);
+
+#endif // _TIMERQ_H_
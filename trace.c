@@ -0,0 +1,132 @@
+/**
+* @file trace.c
+* @brief Operation trace recorder and loader
+*/
+
+#include <sys/stat.h>
+#include "trace.h"
+
+const char *trace_op_name[TRACE_OP_COUNT] =
+{
+	"-", "insert", "append", "delete", "print", "lookup", "push", "pop"
+};
+
+/*!*******************************************************
+*	\fn trace_open(const char *path)
+*	\brief - start a recording
+*	\param path - trace file, truncated
+*	\return trace_writer * - recorder, NULL on failure
+*********************************************************/
+trace_writer* trace_open(const char *path)
+{
+	trace_writer *tw = (trace_writer*) malloc(sizeof(*tw));
+	trace_header hdr;
+
+	if(NULL == tw)
+		return (NULL);
+	tw->fp = fopen(path, "wb");
+	if(NULL == tw->fp)
+	{
+		free(tw);
+		return (NULL);
+	}
+	tw->count = 0;
+	tw->used = 0;
+
+	/* Placeholder, trace_close() rewrites it with the final count */
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = TRACE_MAGIC;
+	hdr.version = TRACE_VERSION;
+	fwrite(&hdr, sizeof(hdr), 1, tw->fp);
+	return (tw);
+}
+
+/*!*******************************************************
+*	\fn trace_open_env(void)
+*	\brief - trace_open() on the file named by TRACE_ENV
+*	\return trace_writer * - recorder, NULL if TRACE_ENV is unset or
+*		 the file can't be created
+*********************************************************/
+trace_writer* trace_open_env(void)
+{
+	const char *path = getenv(TRACE_ENV);
+	if(NULL == path)
+		return (NULL);
+	return (trace_open(path));
+}
+
+/*!*******************************************************
+*	\fn trace_close(trace_writer *tw)
+*	\brief - flush the recording, fill in the header and free tw
+*	\param tw - recorder, may be NULL
+*	\return bool - FALSE if anything failed to be written
+*********************************************************/
+bool trace_close(trace_writer *tw)
+{
+	trace_header hdr;
+	bool ok = TRUE;
+
+	if(NULL == tw)
+		return (TRUE);
+	if((0 != tw->used) && (tw->used != fwrite(tw->buf, sizeof(trace_rec), tw->used, tw->fp)))
+		ok = FALSE;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = TRACE_MAGIC;
+	hdr.version = TRACE_VERSION;
+	hdr.count = tw->count;
+	if((0 != fseek(tw->fp, 0, SEEK_SET)) || (1 != fwrite(&hdr, sizeof(hdr), 1, tw->fp)))
+		ok = FALSE;
+	/* Buffered record writes that failed earlier show up here too */
+	if((0 != ferror(tw->fp)) || (0 != fclose(tw->fp)))
+		ok = FALSE;
+	free(tw);
+	return (ok);
+}
+
+/*!*******************************************************
+*	\fn trace_load(const char *path, size_t *n)
+*	\brief - read a whole trace into memory
+*	\param path - trace file
+*	\param n - out: number of records
+*	\return trace_rec * - records (free() them), NULL if the file can't
+*		 be read, is not a trace or holds an unknown operation
+*********************************************************/
+trace_rec* trace_load(const char *path, size_t *n)
+{
+	FILE *fp = fopen(path, "rb");
+	trace_rec *recs = NULL;
+	trace_header hdr;
+	struct stat sb;
+	size_t i = 0;
+
+	if(NULL == fp)
+		return (NULL);
+	if((1 != fread(&hdr, sizeof(hdr), 1, fp)) || (TRACE_MAGIC != hdr.magic) ||
+	   (TRACE_VERSION != hdr.version))
+		goto bad;
+
+	/* A corrupt count must not size the allocation: the records have to
+	   be in the file */
+	if((0 != fstat(fileno(fp), &sb)) || (sb.st_size < (off_t) sizeof(hdr)) ||
+	   (hdr.count > (((uint64_t) sb.st_size - sizeof(hdr)) / sizeof(*recs))))
+		goto bad;
+
+	/* malloc(0) may return NULL, keep an empty trace loadable */
+	recs = (trace_rec*) malloc((hdr.count + 1) * sizeof(*recs));
+	if((NULL == recs) || (hdr.count != fread(recs, sizeof(*recs), hdr.count, fp)))
+		goto bad;
+	for(i = 0; i < hdr.count; i++)
+	{
+		if((recs[i].op < TRACE_INSERT) || (recs[i].op >= TRACE_OP_COUNT))
+			goto bad;
+	}
+	fclose(fp);
+	*n = (size_t) hdr.count;
+	return (recs);
+
+bad:
+	free(recs);
+	fclose(fp);
+	return (NULL);
+}
@@ -0,0 +1,139 @@
+/**
+* @file trace.h
+* @brief Binary operation traces. The interactive drivers (llist.c main()
+*        and heapsort.c main()) record every operation they perform when
+*        built with -DTRACE, and replay.c plays a trace back against any of
+*        the engines as fast as it can.
+*
+*        Layout: one trace_header, then trace_header.count trace_rec in the
+*        order the operations were issued. Host byte order.
+*/
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdint.h>
+#include "heapsort.h"
+
+/** "HTRC" */
+#define TRACE_MAGIC		(0x43525448u)
+
+/** Bumped whenever trace_header, trace_rec or trace_op change */
+#define TRACE_VERSION		(1)
+
+/** Records buffered by the recorder between writes */
+#define TRACE_BUF_RECS		(4096)
+
+/** Environment variable naming the file a -DTRACE build records to */
+#define TRACE_ENV		"TRACE_FILE"
+
+/** Operations. The numbering is part of the file format. */
+typedef enum _trace_op
+{
+	TRACE_INSERT = 1,	/**< insert_node() / add_node() without HEAPSORT */
+	TRACE_APPEND,		/**< append_link_node() */
+	TRACE_DELETE,		/**< delete_node() */
+	TRACE_PRINT,		/**< print_nodes() */
+	TRACE_LOOKUP,		/**< find_node() */
+	TRACE_PUSH,		/**< add_node() with HEAPSORT */
+	TRACE_POP,		/**< extract_min(), arg is unused */
+	TRACE_OP_COUNT
+}trace_op;
+
+/** Printable operation names, indexed by trace_op */
+extern const char *trace_op_name[TRACE_OP_COUNT];
+
+/**
+	\brief struct trace_header: first 16 bytes of a trace file
+*/
+typedef struct trace_header
+{
+	uint32_t magic;
+	uint16_t version;
+	uint16_t reserved;
+	/** Number of trace_rec */
+	uint64_t count;
+}trace_header;
+
+/**
+	\brief struct trace_rec: one operation
+*/
+typedef struct trace_rec
+{
+	/** trace_op */
+	uint32_t op;
+	/** Operand */
+	int32_t arg;
+}trace_rec;
+
+/**
+	\brief struct trace_writer: an open recording
+*/
+typedef struct trace_writer
+{
+	FILE *fp;
+	/** Records written so far, buffered ones included */
+	uint64_t count;
+	/** Records not yet written */
+	size_t used;
+	trace_rec buf[TRACE_BUF_RECS];
+}trace_writer;
+
+/*!*******************************************************
+*	\fn trace_open(const char *path)
+*	\brief - start a recording
+*	\param path - trace file, truncated
+*	\return trace_writer * - recorder, NULL on failure
+*********************************************************/
+trace_writer* trace_open(const char *path);
+
+/*!*******************************************************
+*	\fn trace_open_env(void)
+*	\brief - trace_open() on the file named by TRACE_ENV
+*	\return trace_writer * - recorder, NULL if TRACE_ENV is unset or
+*		 the file can't be created
+*********************************************************/
+trace_writer* trace_open_env(void);
+
+/*!*******************************************************
+*	\fn trace_record(trace_writer *tw, trace_op op, int arg)
+*	\brief - append one operation
+*	\param tw - recorder, may be NULL (then nothing is recorded)
+*	\param op - operation
+*	\param arg - operand
+*	\return void
+*********************************************************/
+static inline void trace_record(trace_writer *tw, trace_op op, int arg)
+{
+	if(NULL == tw)
+		return;
+	if(TRACE_BUF_RECS == tw->used)
+	{
+		fwrite(tw->buf, sizeof(trace_rec), tw->used, tw->fp);
+		tw->used = 0;
+	}
+	tw->buf[tw->used].op = (uint32_t) op;
+	tw->buf[tw->used].arg = (int32_t) arg;
+	tw->used++;
+	tw->count++;
+}
+
+/*!*******************************************************
+*	\fn trace_close(trace_writer *tw)
+*	\brief - flush the recording, fill in the header and free tw
+*	\param tw - recorder, may be NULL
+*	\return bool - FALSE if anything failed to be written
+*********************************************************/
+bool trace_close(trace_writer *tw);
+
+/*!*******************************************************
+*	\fn trace_load(const char *path, size_t *n)
+*	\brief - read a whole trace into memory
+*	\param path - trace file
+*	\param n - out: number of records
+*	\return trace_rec * - records (free() them), NULL if the file can't
+*		 be read, is not a trace or holds an unknown operation
+*********************************************************/
+trace_rec* trace_load(const char *path, size_t *n);
+
+#endif // _TRACE_H_